@@ -19,3 +19,9 @@ struct BootloaderData
 };
 
 BootloaderData GetBootloaderData();
+
+/*
+    Replaces the responses the kernel keeps using with heap copies, and drops the
+    ones only needed during boot, so bootloader reclaimable memory can be freed.
+*/
+void CopyBootloaderData(BootloaderData *data);
@@ -4,14 +4,117 @@
     * Created 01/09/2023 DanielH
 */
 
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <sched/preempt.hpp>
+
 namespace Kernel {
     namespace CPU {
+        constexpr size_t KernelStackSize = 0x8000;
+
         inline void NoOp() { asm volatile ("nop"); }
         inline void Pause() { asm volatile ("pause"); }
         inline void Halt() { asm volatile ("hlt"); }
         inline void ClearInterrupts() { asm volatile ("cli"); }
         inline void SetInterrupts() { asm volatile ("sti"); }
 
+        /* Disables interrupts and returns the previous RFLAGS, to be handed back to RestoreInterrupts. */
+        inline uint64_t SaveAndDisableInterrupts() {
+            uint64_t flags;
+            asm volatile ("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+            return flags;
+        }
+
+        /* Also makes the thread switch PreemptPoint had to put off while interrupts were disabled */
+        inline void RestoreInterrupts(uint64_t flags) {
+            if (!(flags & (1 << 9))) return; // RFLAGS.IF
+            asm volatile ("sti" : : : "memory");
+
+            CPUData *cpu = ThisCPU();
+            if (cpu->NeedResched && cpu->CurrentThread && !cpu->PreemptCount) Sched::PreemptPoint();
+        }
+
+        inline uint64_t ReadCR0() {
+            uint64_t value;
+            asm volatile ("mov %%cr0, %0" : "=r"(value));
+            return value;
+        }
+
+        inline void WriteCR0(uint64_t value) {
+            asm volatile ("mov %0, %%cr0" : : "r"(value) : "memory");
+        }
+
+        inline uint64_t ReadCR3() {
+            uint64_t value;
+            asm volatile ("mov %%cr3, %0" : "=r"(value));
+            return value;
+        }
+
+        /* Writing CR3 flushes every non-global TLB entry */
+        inline void WriteCR3(uint64_t value) {
+            asm volatile ("mov %0, %%cr3" : : "r"(value) : "memory");
+        }
+
+        inline void InvalidatePage(uintptr_t virt) {
+            asm volatile ("invlpg (%0)" : : "r"(virt) : "memory");
+        }
+
+        inline uint64_t ReadCR4() {
+            uint64_t value;
+            asm volatile ("mov %%cr4, %0" : "=r"(value));
+            return value;
+        }
+
+        inline void WriteCR4(uint64_t value) {
+            asm volatile ("mov %0, %%cr4" : : "r"(value) : "memory");
+        }
+
+        enum INVPCIDType : uint64_t {
+            INVPCID_ADDRESS = 0,
+            INVPCID_SINGLE_CONTEXT = 1,
+            INVPCID_ALL_INCLUDING_GLOBAL = 2,
+            INVPCID_ALL = 3,
+        };
+
+        inline void InvalidatePCID(INVPCIDType type, uint64_t pcid, uintptr_t virt) {
+            struct { uint64_t PCID; uint64_t Address; } descriptor = { pcid, virt };
+            asm volatile ("invpcid %0, %1" : : "m"(descriptor), "r"((uint64_t)type) : "memory");
+        }
+
+        inline uint64_t ReadMSR(uint32_t msr) {
+            uint32_t low, high;
+            asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+            return ((uint64_t)high << 32) | low;
+        }
+
+        inline void WriteMSR(uint32_t msr, uint64_t value) {
+            asm volatile ("wrmsr" : : "a"((uint32_t)value), "d"((uint32_t)(value >> 32)), "c"(msr) : "memory");
+        }
+
+        /* Time stamp counter, for cycle counts. */
+        inline uint64_t ReadTSC() {
+            uint32_t low, high;
+            asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+            return ((uint64_t)high << 32) | low;
+        }
+
         void Initialize();
+
+        /*
+            Programs this CPU's PAT as WB, WC, UC-, UC, WB, WP, UC-, WT, so the PWT/PCD/PAT
+            bits of a mapping index it directly (see VMM::MapFlags). The first four
+            entries only differ from the power-on default in WC replacing WT.
+        */
+        void InitializePAT();
+
+        /* Allocates a kernel stack and returns its top, ready to be loaded into RSP. Panics if there's no memory. */
+        void *AllocateKernelStack();
+        /* Like AllocateKernelStack, but returns nullptr if there's no memory */
+        void *TryAllocateKernelStack();
+        /* Takes the top returned by (Try)AllocateKernelStack, nothing may still run on the stack */
+        void FreeKernelStack(void *stackTop);
+        /* Continues execution in target on the given stack, the current stack is abandoned. */
+        __attribute__((noreturn)) void SwitchStack(void *stackTop, void (*target)());
     }
 }
@@ -29,6 +29,9 @@ struct MADTHeader {
 }__attribute__((packed));
 
 namespace Kernel::CPU {
+    /* LAPIC timer interrupts per second on every CPU, each one is a scheduler tick */
+    constexpr uint32_t TimerFrequency = 100;
+
     void InitializeLAPIC();
     void InitializeIOAPIC();
     void InitializeMADT();
@@ -36,4 +39,14 @@ namespace Kernel::CPU {
     void TimerReset();
     bool CalibrateTimer();
     uint32_t GetApicId();
+    /* Sends a fixed interrupt to the CPU with the given Local APIC ID */
+    void SendIPI(uint32_t apicId, uint8_t vector);
+    /* Delivered once this CPU can take it, e.g. after the interrupt handler it was sent from returns */
+    void SendIPISelf(uint8_t vector);
+    /*
+        Sends a fixed interrupt to every CPU in the system with a single ICR write, also
+        those the kernel didn't bring up. Only for once every CPU is online and has the
+        vector set up.
+    */
+    void BroadcastIPI(uint8_t vector, bool includeSelf = false);
 }
\ No newline at end of file
@@ -39,5 +39,6 @@ namespace Kernel::CPU::Interrupts {
     void Install();
     void CreateIDTEntry(int interrupt, void *handler, uint8_t gate_type);
     void ResetTimerTicks();
-    size_t GetTimerTicks();
+    /* LAPIC timer ticks counted on the BSP, lastTickTSC (if given) gets the TSC at the last one */
+    size_t GetTimerTicks(uint64_t *lastTickTSC = nullptr);
 }
\ No newline at end of file
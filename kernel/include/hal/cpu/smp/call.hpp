@@ -0,0 +1,45 @@
+/*
+    * call.hpp
+    * Running functions on other CPUs through IPIs
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <hal/cpu/interrupt/idt.hpp>
+#include <hal/cpu/smp/percpu.hpp>
+
+namespace Kernel::CPU {
+    constexpr uint8_t CallFunctionVector = 0xF2;
+
+    /* Bit n stands for the CPU with index n */
+    using CPUMask = uint64_t;
+    static_assert(MaxCPUCount <= 64, "CPUMask needs a bit per CPU");
+
+    constexpr CPUMask AllCPUs = ~(CPUMask)0;
+
+    constexpr CPUMask CPUMaskOf(size_t cpu) {
+        return (CPUMask)1 << cpu;
+    }
+
+    /* Calls each CPU can have queued before callers have to wait for room */
+    constexpr size_t CallQueueSize = 16;
+
+    /*
+        Runs function(argument) on every online CPU in the mask. The calling CPU runs it
+        directly, the others from an IPI. Either way it runs with interrupts disabled, so
+        it must be short and can't block (it can queue deferred work). With wait set this
+        returns once every CPU is done. Otherwise it returns once the calls are queued,
+        and the argument has to outlive them.
+        Waiting needs interrupts enabled, so not from interrupt handlers or while holding
+        an IRQ saving lock: a CPU spinning on that lock with interrupts off would never
+        take the call. It panics if interrupts are disabled.
+        Returns how many CPUs the function was handed to.
+    */
+    size_t SmpCallFunction(CPUMask mask, void (*function)(void *), void *argument, bool wait);
+
+    /* Runs this CPU's queued calls, for code that spins with interrupts disabled */
+    void ServiceCallQueue();
+
+    __attribute__((interrupt)) void CallFunctionInterrupt(Interrupts::CInterruptRegisters *);
+}
@@ -0,0 +1,70 @@
+/*
+    * percpu.hpp
+    * Per-CPU data, reached through the GS base
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Kernel::Sched {
+    struct Thread;
+}
+
+namespace Kernel::CPU {
+    /* Upper bound on the number of CPUs brought online, sizes per-CPU arrays. */
+    constexpr size_t MaxCPUCount = 64;
+
+    /*
+        Every CPU's own block, IA32_GS_BASE points at it. There's no user mode yet, so
+        IA32_KERNEL_GS_BASE holds the same pointer and a swapgs can't lose it.
+    */
+    struct CPUData {
+        /* Points back at this block, so ThisCPU() is a single GS-relative load */
+        CPUData *Self;
+        /* Dense index, 0 is the BSP */
+        size_t Index;
+        uint32_t ApicId;
+        /* Nesting depth of PreemptDisable, the scheduler only switches threads at 0 */
+        uint32_t PreemptCount;
+        /* The timer wanted to switch threads while PreemptCount was raised */
+        bool NeedResched;
+        /* nullptr until the CPU has entered Idle and with it the scheduler */
+        Sched::Thread *CurrentThread;
+    };
+
+    inline CPUData *ThisCPU() {
+        CPUData *data;
+        asm volatile ("mov %%gs:0, %0" : "=r"(data));
+        return data;
+    }
+
+    /* Points this CPU's GS base at data, the first thing every CPU does. The BSP passes nullptr for its static block. */
+    void LoadCPUData(CPUData *data);
+    /* Sets up a block for the CPU with the given index, in a page of its own */
+    CPUData *CreateCPUData(size_t index, uint32_t apicId);
+
+    /*
+        One instance of T per CPU, each on its own cache lines. Local() is the
+        calling CPU's and [] reaches any CPU's. Whoever uses Local() has to stay
+        on that CPU until it's done with it.
+    */
+    template <typename T> class PerCPU {
+        struct alignas(64) Slot {
+            T Value;
+        };
+
+        Slot Slots[MaxCPUCount];
+
+    public:
+        T &Local() {
+            return Slots[ThisCPU()->Index].Value;
+        }
+
+        T &operator[](size_t index) {
+            return Slots[index].Value;
+        }
+    };
+}
+
+#define PERCPU_CREATE(type, name) Kernel::CPU::PerCPU<type> name
@@ -6,8 +6,30 @@
 #pragma once
 #include <limine.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <hal/cpu/smp/percpu.hpp>
 
 namespace Kernel::CPU {
     void CPUJump(uint32_t Core, void* Target);
     void SetupAllCPUs();
+
+    /* Returns a dense index (0 = BSP) for the calling CPU. */
+    inline size_t GetCPUIndex() {
+        return ThisCPU()->Index;
+    }
+
+    size_t GetCPUCount();
+    uint32_t GetCPUApicId(size_t index);
+    /* Whether the CPU has loaded the kernel page tables and takes interrupts, so needs TLB shootdowns */
+    bool IsCPUOnline(size_t index);
+
+    /*
+        Hands a function to an idle CPU and wakes it up to run it, in its idle thread.
+        Returns false if the CPU doesn't exist or still has work pending. For
+        short calls with interrupts disabled, see SmpCallFunction.
+    */
+    bool RunOnCPU(size_t index, void (*function)(void *), void *argument);
+
+    /* What every CPU does once it has nothing left to initialize, it becomes the CPU's idle thread. */
+    __attribute__((noreturn)) void Idle();
 }
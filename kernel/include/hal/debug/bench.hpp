@@ -0,0 +1,11 @@
+/*
+    * bench.hpp
+    * In-kernel benchmarks, built with make BENCHMARKS=1
+    * Created 17/10/2026
+*/
+#pragma once
+
+namespace Kernel::Debug {
+    /* Runs every benchmark and logs the results, called at the end of boot. */
+    void RunBenchmarks();
+}
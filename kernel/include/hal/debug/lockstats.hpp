@@ -0,0 +1,38 @@
+/*
+    * lockstats.hpp
+    * Lock contention statistics, built with make LOCKSTATS=1
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+
+namespace Kernel::Debug {
+    class SerialPort;
+
+    /*
+        Embedded in every Spinlock and QueuedSpinlock when KERNEL_LOCK_STATS is defined.
+        Everything but Next is only written by the lock's current holder, so no atomics
+        are needed. Locks without a name aren't tracked.
+    */
+    struct LockStats {
+        const char *Name;
+        uint64_t Acquisitions = 0;
+        uint64_t Contended = 0;
+        /* TSC cycles spent waiting, over the contended acquisitions */
+        uint64_t SpinCycles = 0;
+        uint64_t MaxHoldCycles = 0;
+        uint64_t AquiredAt = 0;
+        bool Registered = false;
+        LockStats *Next = nullptr;
+
+        constexpr LockStats(const char *name) : Name(name) {}
+    };
+
+    /* Called right after the lock was taken, start is the TSC from before trying to take it */
+    void LockStatsAquired(LockStats *stats, uint64_t start, bool contended);
+    /* Called right before the lock is released */
+    void LockStatsReleasing(LockStats *stats);
+
+    /* Writes a table of every named lock used so far, locks sharing a name are summed. */
+    void DumpLockStats(SerialPort *port);
+}
@@ -0,0 +1,34 @@
+/*
+    * fpu.hpp
+    * Kernel use of the FPU and vector registers
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Kernel::CPU {
+    enum SIMDLevel {
+        SIMD_NONE = 0,
+        SIMD_SSE2 = 1,
+        SIMD_AVX2 = 2,
+    };
+
+    /*
+        Turns on SSE (and XSAVE and AVX where supported) on this CPU. Every CPU
+        calls this before running anything else, the BSP's call decides the
+        SIMD level for all of them.
+    */
+    void InitializeFPU();
+}
+
+/*
+    The kernel is built without vector registers, so interrupt handlers and
+    ordinary code never touch them. Code built from a *.sse2.c / *.avx2.c file
+    may, but only between KernelFpuBegin and KernelFpuEnd, which save and
+    restore this CPU's extended state around it. Interrupts are off in between,
+    so keep the sections short. Sections nest.
+*/
+extern "C" int GetSIMDLevel();
+extern "C" void KernelFpuBegin();
+extern "C" void KernelFpuEnd();
@@ -0,0 +1,117 @@
+/*
+    * rwlock.hpp
+    * Reader-writer locks and sequence locks
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/cpu/smp/smp.hpp>
+
+namespace Kernel {
+    /*
+        Reader-writer lock for read-mostly data. Every CPU counts its readers on its
+        own cache line, so readers on different CPUs never write to the same line.
+        Writers are expensive in exchange: they wait for the count on every CPU to
+        drain. New readers wait for a pending writer, so a read lock can't be taken
+        recursively, and if an interrupt handler writes, readers need the IRQ saving
+        variants.
+    */
+    class RWLock {
+    public:
+        /* Names the writers' lock in the lock statistics */
+        constexpr RWLock(const char *name = nullptr) : WriterLock(name) {}
+
+        void AquireRead();
+        void ReleaseRead();
+        void AquireWrite();
+        void ReleaseWrite();
+
+        uint64_t AquireReadIrqSave() {
+            uint64_t flags = CPU::SaveAndDisableInterrupts();
+            AquireRead();
+            return flags;
+        }
+
+        void ReleaseReadIrqRestore(uint64_t flags) {
+            ReleaseRead();
+            CPU::RestoreInterrupts(flags);
+        }
+
+        uint64_t AquireWriteIrqSave() {
+            uint64_t flags = CPU::SaveAndDisableInterrupts();
+            AquireWrite();
+            return flags;
+        }
+
+        void ReleaseWriteIrqRestore(uint64_t flags) {
+            ReleaseWrite();
+            CPU::RestoreInterrupts(flags);
+        }
+
+    private:
+        /*
+            A reader might be released on another CPU than it took the lock on, only the sum of all counts means anything.
+            Padded rather than aligned: 64 bytes apart every count has a line of its own wherever the lock is, and
+            locks embedded in heap objects don't need an over-aligned operator new.
+        */
+        struct ReaderCount {
+            int32_t Count;
+            uint8_t Padding[60];
+        };
+
+        ReaderCount Readers[CPU::MaxCPUCount] = {};
+        bool Writing = false;
+        Spinlock WriterLock;
+    };
+
+    /*
+        Sequence lock for small values that are read far more often than they're
+        written (e.g. the timer clock). Readers don't write anything, they copy the
+        value and retry if a writer got in the way:
+
+            uint32_t sequence;
+            do {
+                sequence = lock.ReadBegin();
+                copy = value;
+            } while (lock.ReadRetry(sequence));
+
+        The protected value should be volatile, a reader can see it half written.
+        A reader spins while a write is in progress, so never read from an interrupt
+        handler that may have interrupted the writer on the same CPU.
+    */
+    class SeqLock {
+    public:
+        uint32_t ReadBegin() {
+            while (true) {
+                uint32_t sequence = __atomic_load_n(&Sequence, __ATOMIC_ACQUIRE);
+                if (!(sequence & 1)) return sequence;
+
+                CPU::Pause();
+            }
+        }
+
+        bool ReadRetry(uint32_t sequence) {
+            /* The reads of the value have to be done before checking that no writer changed it meanwhile */
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            return __atomic_load_n(&Sequence, __ATOMIC_RELAXED) != sequence;
+        }
+
+        /* Writers are serialized among themselves, and must keep interrupts disabled (see above) */
+        void WriteBegin() {
+            WriterLock.Aquire();
+            __atomic_store_n(&Sequence, Sequence + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+        }
+
+        void WriteEnd() {
+            __atomic_store_n(&Sequence, Sequence + 1, __ATOMIC_RELEASE);
+            WriterLock.Release();
+        }
+
+    private:
+        uint32_t Sequence = 0;
+        Spinlock WriterLock;
+    };
+}
@@ -2,10 +2,109 @@
     * spinlock.h
     * Spinlock implementation
     * Created 02/09/2023 DanielH
+    * Ticket and queued locks 17/10/2026
 */
 #pragma once
+#include <stdint.h>
+#include <hal/cpu.hpp>
+#include <hal/debug/lockstats.hpp>
 
+/*
+    Test-and-set lock. Smallest and cheapest uncontended, but unfair and every waiter hammers the same line.
+    Unlike the classes below it leaves preemption alone, a holder that gets switched out leaves everyone else
+    spinning. Hold it with interrupts disabled.
+*/
 #define SPINLOCK_CREATE(name) volatile bool name = false
 
 extern "C" void SpinlockAquire(volatile bool* lock);
 extern "C" void SpinlockRelease(volatile bool* lock);
+
+namespace Kernel {
+    /*
+        Ticket lock: waiters take a number and are let in in that order, so nobody
+        starves. They all still poll the same line, so it suits locks that are
+        short and only contended by a few CPUs at once.
+    */
+    class Spinlock {
+    public:
+        /* The name is what the lock shows up as in the lock statistics */
+        constexpr Spinlock(const char *name = nullptr)
+#ifdef KERNEL_LOCK_STATS
+            : Stats(name) {}
+#else
+            { (void)name; }
+#endif
+
+        void Aquire();
+        bool TryAquire();
+        void Release();
+
+        /* Disables interrupts before taking the lock, the result goes to ReleaseIrqRestore */
+        uint64_t AquireIrqSave() {
+            uint64_t flags = CPU::SaveAndDisableInterrupts();
+            Aquire();
+            return flags;
+        }
+
+        void ReleaseIrqRestore(uint64_t flags) {
+            Release();
+            CPU::RestoreInterrupts(flags);
+        }
+
+    private:
+        uint32_t Next = 0;
+        uint32_t Owner = 0;
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStats Stats;
+#endif
+    };
+
+    /* A waiter's place in a QueuedSpinlock's queue */
+    struct QueueNode {
+        QueueNode *volatile Next;
+        volatile bool Waiting;
+    }__attribute__((aligned(64)));
+
+    /*
+        MCS queued lock: waiters line up in a list and each spins on its own node,
+        which the previous holder clears to hand the lock over. Under contention a
+        release only touches the next waiter's line instead of every waiter's.
+        Nodes come from a small per-CPU pool, so up to QueueNodesPerCPU queued
+        locks can be held or waited on by one CPU at once (e.g. with interrupts
+        nesting), released in any order.
+    */
+    constexpr size_t QueueNodesPerCPU = 4;
+
+    class QueuedSpinlock {
+    public:
+        constexpr QueuedSpinlock(const char *name = nullptr)
+#ifdef KERNEL_LOCK_STATS
+            : Stats(name) {}
+#else
+            { (void)name; }
+#endif
+
+        void Aquire();
+        bool TryAquire();
+        void Release();
+
+        uint64_t AquireIrqSave() {
+            uint64_t flags = CPU::SaveAndDisableInterrupts();
+            Aquire();
+            return flags;
+        }
+
+        void ReleaseIrqRestore(uint64_t flags) {
+            Release();
+            CPU::RestoreInterrupts(flags);
+        }
+
+    private:
+        QueueNode *Tail = nullptr;
+        /* Only touched by the holder */
+        QueueNode *Holder = nullptr;
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStats Stats;
+#endif
+    };
+}
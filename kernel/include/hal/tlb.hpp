@@ -0,0 +1,33 @@
+/*
+    * tlb.hpp
+    * TLB shootdown across CPUs, and PCIDs
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <hal/cpu/interrupt/idt.hpp>
+#include <hal/vmm.hpp>
+
+namespace Kernel::VMM {
+    constexpr uint8_t TLBShootdownVector = 0xF0;
+
+    /* Turns on global pages, and PCIDs where supported, on this CPU. Called once the kernel CR3 is loaded. */
+    void InitializeTLB();
+
+    /* Loads a page map on this CPU, keeping its TLB entries if it still has a PCID here */
+    void SwitchPageMap(PageTable *pagemap);
+
+    /*
+        Invalidates [virt, virt + length) of a page map in the TLB of every online CPU,
+        after the page tables have been changed. Returns once every CPU has done so.
+        Pages for the same CPU are batched into one IPI, large ranges flush
+        everything. freedTables says page tables covering the range were freed.
+    */
+    void FlushTLB(PageTable *pagemap, uintptr_t virt, size_t length, bool freedTables = false);
+
+    /* Runs this CPU's queued invalidations, for code that spins with interrupts disabled */
+    void ServiceTLBShootdowns();
+
+    __attribute__((interrupt)) void TLBShootdownInterrupt(CPU::Interrupts::CInterruptRegisters *);
+}
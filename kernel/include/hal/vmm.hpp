@@ -5,6 +5,7 @@
 */
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #include <limine.h>
 
 struct PageTableEntry {
@@ -16,7 +17,8 @@ struct PageTableEntry {
     uintptr_t Accessed : 1;
     uintptr_t Ignored : 1;
     uintptr_t PageSize : 1;
-    uintptr_t Ignored1 : 4;
+    uintptr_t Global : 1; // Leaves only, kept in the TLB across CR3 loads with CR4.PGE set
+    uintptr_t Ignored1 : 3;
     uintptr_t PhysicalAddr : 40;
     uintptr_t Reserved : 12;
 }__attribute__((packed));
@@ -27,11 +29,63 @@ struct PageTable {
 
 extern "C" void LoadCR3(void *pml4);
 
+/* Kernel virtual address space layout, besides the HHDM and the kernel image. */
+constexpr uintptr_t KernelHalfBase = 0xFFFF800000000000;
+constexpr uintptr_t KernelHeapBase = 0xFFFFC00000000000;
+constexpr size_t KernelHeapSize = 0x1000000000; // 64 GiB
+
 uintptr_t HHDMVirtToPhys(uintptr_t virt);
 uintptr_t HHDMPhysToVirt(uintptr_t phys);
 
 namespace Kernel::VMM {
+    constexpr uint32_t MapCacheShift = 3;
+
+    enum MapFlags : uint32_t {
+        MAP_WRITE = 1 << 0,
+        MAP_USER = 1 << 1,
+        /* Only use 4 KiB pages, for ranges that will be remapped piecemeal later */
+        MAP_NO_LARGE = 1 << 2,
+
+        /* Memory type, the index of the PAT entry to use (see CPU::InitializePAT). Write-back by default. */
+        MAP_CACHE_WB = 0 << MapCacheShift,
+        MAP_CACHE_WC = 1 << MapCacheShift,
+        MAP_CACHE_UC_MINUS = 2 << MapCacheShift,
+        MAP_CACHE_UC = 3 << MapCacheShift,
+        MAP_CACHE_WP = 5 << MapCacheShift,
+        MAP_CACHE_WT = 7 << MapCacheShift,
+        MAP_CACHE_MASK = 7 << MapCacheShift,
+    };
+
+    enum MapError {
+        MAP_OK,
+        MAP_ERROR_NO_PAGEMAP,
+        MAP_ERROR_UNALIGNED,
+        MAP_ERROR_NO_MEMORY,
+        MAP_ERROR_NOT_MAPPED,
+    };
+
+    void InitializeHHDM(uintptr_t offset);
     void InitPaging(limine_memmap_response memmap, limine_kernel_address_response kaddr);
     void LoadKernelCR3();
-    bool MemoryMap(PageTable *target_pagemap, uintptr_t virt, uintptr_t phys, bool largePage);
+    PageTable *GetKernelPageMap();
+
+    /*
+        Range operations on a page map (nullptr is the kernel's). Addresses and lengths
+        must be page aligned. Each walks the tables once, using 2 MiB/1 GiB pages
+        wherever the range allows, and shoots the old translations down on every CPU.
+        Kernel half mappings are global unless MAP_USER is given.
+    */
+    MapError MapRange(PageTable *pagemap, uintptr_t virt, uintptr_t phys, size_t length, uint32_t flags);
+    /* Maps count 4 KiB pages at virt to the given, not necessarily contiguous, frames */
+    MapError MapPages(PageTable *pagemap, uintptr_t virt, const uintptr_t *frames, size_t count, uint32_t flags);
+    /*
+        Unmaps a range and waits for every CPU to drop it from its TLB. If frames is set it
+        receives the physical address of each 4 KiB page that was mapped (0 for holes),
+        so the caller can free them once nothing can reach them any more.
+    */
+    MapError UnmapRange(PageTable *pagemap, uintptr_t virt, size_t length, uintptr_t *frames = nullptr);
+    MapError ProtectRange(PageTable *pagemap, uintptr_t virt, size_t length, uint32_t flags);
+
+    bool GetPhysicalAddress(PageTable *pagemap, uintptr_t virt, uintptr_t *phys);
+    const char *MapErrorString(MapError error);
 }
\ No newline at end of file
@@ -10,6 +10,6 @@
 namespace Kernel {
     /* Wrapper around __cpuid GCC macro to allow it to simply be used with the & operator. */
     static inline void Cpuid(uint32_t level, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
-        __cpuid(level, eax, ebx, ecx, edx);
+        __cpuid(level, *eax, *ebx, *ecx, *edx);
     }
 }
\ No newline at end of file
@@ -4,8 +4,12 @@
     * Created 09/09/2023
 */
 #pragma once
+#include <stddef.h>
 
 extern "C" int strncmp(const char *str1, const char *str2, int n);
 extern "C" int strlen(const char *str);
 extern "C" int strnlen(const char *str, int n);
 extern "C" const char *strcpy(char *dest, const char *src);
+extern "C" void *memchr(const void *buffer, int c, size_t n);
+extern "C" char *strchr(const char *str, int c);
+extern "C" char *strrchr(const char *str, int c);
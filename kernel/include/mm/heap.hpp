@@ -3,11 +3,24 @@
     * Implements a heap memory allocator.
     * Created 16/09/2023 DanielH
 */
+#pragma once
 #include <stddef.h>
 
 namespace Kernel::Mem {
+    struct HeapStatistics {
+        /* Memory taken from the PMM, including allocator overhead */
+        size_t HeapSize;
+        size_t FreeSize;
+        size_t FreeBlocks;
+        /* The biggest allocation that would currently succeed without growing the heap */
+        size_t LargestFreeBlock;
+        /* Percentage of free memory outside of the largest free block, 0 means no fragmentation */
+        size_t Fragmentation;
+    };
+
     void InitializeHeap(size_t heapSize);
     void *Allocate(size_t size);
     void Free(void *base);
     void *Reallocate(void *object, size_t new_size);
-}
\ No newline at end of file
+    HeapStatistics GetHeapStatistics();
+}
@@ -5,9 +5,16 @@
 */
 
 #pragma once
+#include <stddef.h>
 
 #define ALIGN_UP(value, boundary) (((value) + ((boundary) - 1)) / (boundary) * (boundary))
 #define ALIGN_DOWN(value, boundary)  ((value) & (~((boundary) - 1)))
 
-extern "C" void* memcpy(void* destination, void* source, unsigned long n);
-extern "C" void* memset(void* destination, int val, unsigned long n);
+extern "C" void* memcpy(void* destination, const void* source, size_t n);
+extern "C" void* memmove(void* destination, const void* source, size_t n);
+extern "C" void* memset(void* destination, int val, size_t n);
+extern "C" int memcmp(const void* buffer1, const void* buffer2, size_t n);
+
+/* The vector copies memcpy dispatches to, only to be called between KernelFpuBegin/KernelFpuEnd */
+extern "C" void CopySSE2(void* destination, const void* source, size_t n);
+extern "C" void CopyAVX2(void* destination, const void* source, size_t n);
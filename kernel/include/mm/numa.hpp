@@ -0,0 +1,27 @@
+/*
+    * numa.hpp
+    * NUMA topology from the ACPI SRAT and SLIT
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Kernel::Mem {
+    /* Proximity domains beyond this are folded into node 0. */
+    constexpr size_t MaxNUMANodes = 8;
+
+    /* Parses the SRAT/SLIT and moves free memory onto per-node zones. Needs ACPI to be initialized. */
+    void InitializeNUMA();
+
+    size_t GetNodeCount();
+    uint8_t GetNodeForAddress(uintptr_t phys);
+    uint8_t GetNodeDistance(uint8_t from, uint8_t to);
+
+    /* Every node, nearest first, starting with the node itself. GetNodeCount() entries long. */
+    const uint8_t *GetNodeFallbackList(uint8_t node);
+
+    /* Called as the CPUs are numbered so that a CPU index can be turned into a node. */
+    void RegisterCPUNode(size_t cpuIndex, uint32_t lapicId);
+    uint8_t GetCurrentNode();
+}
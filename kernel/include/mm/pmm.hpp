@@ -6,9 +6,91 @@
 
 #pragma once
 #include <limine.h>
+#include <stddef.h>
+#include <stdint.h>
 
 namespace Kernel::Mem {
+    /* The largest block the buddy allocator hands out is 2^MaxPageOrder pages (4 MiB). */
+    constexpr unsigned int MaxPageOrder = 10;
+
+    enum PageAllocFlags : uint32_t {
+        /* The returned memory is zero-filled (default) */
+        PAGE_ALLOC_ZERO = 0,
+        /* The caller overwrites all of the memory itself, so don't bother zeroing it */
+        PAGE_ALLOC_NO_ZERO = 1 << 0,
+        /* Only take from the page caches and the buddy allocator, never from the pre-zeroed pool */
+        PAGE_ALLOC_NO_POOL = 1 << 1,
+    };
+
+    enum PageFrameFlags : uint8_t {
+        /* Not handed out by the allocator (firmware, kernel image, PMM metadata...) */
+        PAGE_FRAME_RESERVED = 1 << 0,
+        /* Head of a free block on the buddy lists, Order says how big it is */
+        PAGE_FRAME_FREE = 1 << 1,
+        /* Free, but parked in a per-CPU page cache or the zeroed pool */
+        PAGE_FRAME_CACHED = 1 << 2,
+        /* Was a block head until it was merged into a larger free block */
+        PAGE_FRAME_MERGED = 1 << 3,
+    };
+
+    enum PageOwner : uint8_t {
+        PAGE_OWNER_NONE,
+        PAGE_OWNER_KERNEL,
+        PAGE_OWNER_PMM,
+        PAGE_OWNER_PAGETABLE,
+        PAGE_OWNER_HEAP,
+        PAGE_OWNER_STACK,
+        PAGE_OWNER_SLAB,
+        PAGE_OWNER_COUNT
+    };
+
+    /*
+        One descriptor per physical page frame. Only the first frame of an
+        allocated or free block carries meaningful state.
+    */
+    struct PageFrame {
+        uint32_t RefCount;
+        uint8_t Flags;
+        uint8_t Node;
+        uint8_t Order;
+        uint8_t Owner;
+    };
+
+    static_assert(sizeof(PageFrame) == 8, "PageFrame should stay 8 bytes");
+
     void InitializePMM(limine_memmap_response mmap);
-    void *AllocatePage();
+    void *AllocatePage(uint32_t flags = PAGE_ALLOC_ZERO);
     void FreePage(void *addr);
+
+    /* Allocates/frees 2^order physically contiguous pages. Addresses are physical. */
+    void *AllocatePages(unsigned int order, uint32_t flags = PAGE_ALLOC_ZERO);
+    void FreePages(void *addr, unsigned int order);
+    /* Whether addr is the head of an allocated block of that order, i.e. whether freeing it would be accepted */
+    bool IsAllocatedBlock(void *addr, unsigned int order);
+
+    /* Hands bootloader and ACPI reclaimable memory to the allocator, nothing may reference it anymore. */
+    void ReclaimBootMemory(limine_memmap_response mmap);
+
+    /* Zeroes one page into the pre-zeroed pool. Meant for idle CPUs, returns false once the pool is full or no free pages are left. */
+    bool FillZeroedPagePool();
+
+    /* Returns the smallest order whose block holds at least pageCount pages. */
+    unsigned int PageOrder(size_t pageCount);
+    size_t GetFreeMemory();
+    size_t GetNodeFreeMemory(uint8_t node);
+
+    /* Tags the frames in [base, end) with a NUMA node, RebuildZones then moves their free memory over. */
+    void AssignPageNode(uintptr_t base, uintptr_t end, uint8_t node);
+    void RebuildZones();
+
+    /* Returns the descriptor for a physical address, or nullptr if it's outside of the frame database. */
+    PageFrame *GetPageFrame(uintptr_t phys);
+
+    /* Reference counting for shared pages, ReleasePage frees the block when the count drops to zero. */
+    void ReferencePage(void *addr);
+    void ReleasePage(void *addr);
+
+    /* Records who an allocated block belongs to, for memory accounting. */
+    void SetPageOwner(void *addr, PageOwner owner);
+    size_t GetOwnedMemory(PageOwner owner);
 };
@@ -0,0 +1,118 @@
+/*
+    * slab.hpp
+    * Slab allocator for fixed-size kernel objects
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <hal/spinlock.hpp>
+
+inline void *operator new(size_t, void *place) noexcept {
+    return place;
+}
+
+namespace Kernel::Mem {
+    /* Every slab is one page, with its header at the start of the page. */
+    constexpr size_t SlabSize = 0x1000;
+
+    /* Allocations above this go to the heap instead of a size class. */
+    constexpr size_t MaxSlabObjectSize = 512;
+
+    class SlabCache;
+
+    struct Slab {
+        SlabCache *Cache;
+        Slab *Next;
+        Slab *Prev;
+        void *FreeList;
+        uint32_t InUse;
+        uint32_t Reserved;
+    };
+
+    /*
+        A cache of equally sized objects carved out of whole pages from the PMM.
+        Allocation and free are O(1): slabs with free objects sit on a partial
+        list, and each slab keeps its free objects on an intrusive list.
+        Constructible at compile time, so caches can be plain globals.
+    */
+    class SlabCache {
+        const char *Name;
+        size_t ObjectSize;
+        size_t FirstObject;
+        uint32_t ObjectsPerSlab;
+
+        Slab *Partial = nullptr;
+        Slab *Full = nullptr;
+        Slab *Empty = nullptr;
+
+        size_t SlabCount = 0;
+        size_t ObjectCount = 0;
+
+        Spinlock Lock;
+
+        static constexpr size_t RoundUp(size_t value, size_t boundary) {
+            return (value + boundary - 1) / boundary * boundary;
+        }
+
+        Slab *Grow();
+        void Unlink(Slab **list, Slab *slab);
+        void Push(Slab **list, Slab *slab);
+        void *AllocateLocked();
+        Slab *FreeLocked(void *object);
+
+        public:
+        constexpr SlabCache(const char *name, size_t objectSize, size_t align = 16) :
+            Name(name),
+            ObjectSize(RoundUp(objectSize < sizeof(void *) ? sizeof(void *) : objectSize, align)),
+            FirstObject(RoundUp(sizeof(Slab), align)),
+            ObjectsPerSlab((SlabSize - RoundUp(sizeof(Slab), align)) / RoundUp(objectSize < sizeof(void *) ? sizeof(void *) : objectSize, align)),
+            Lock(name) {}
+
+        void *Allocate();
+        void Free(void *object);
+
+        /* Move several objects under a single lock acquisition, for the per-CPU magazines. */
+        size_t AllocateBatch(void **objects, size_t count);
+        void FreeBatch(void **objects, size_t count);
+
+        const char *GetName() const { return Name; }
+        size_t GetObjectSize() const { return ObjectSize; }
+        size_t GetObjectCount() const { return ObjectCount; }
+        size_t GetSlabCount() const { return SlabCount; }
+    };
+
+    /* Typed front end for a SlabCache, constructs and destroys the objects in place. */
+    template <typename T> class ObjectCache {
+        SlabCache Cache;
+
+        public:
+        constexpr ObjectCache(const char *name) : Cache(name, sizeof(T), alignof(T) > 16 ? alignof(T) : 16) {}
+
+        template <typename... Args> T *New(Args... args) {
+            void *object = Cache.Allocate();
+            if (!object) return nullptr;
+
+            return new (object) T(args...);
+        }
+
+        void Delete(T *object) {
+            if (!object) return;
+
+            object->~T();
+            Cache.Free(object);
+        }
+    };
+
+    /*
+        General purpose size classes, used by Allocate for small objects. Each CPU keeps a
+        magazine of objects per class, so an alloc/free pair normally doesn't touch
+        anything shared. Returns nullptr if size is too large.
+    */
+    void *SlabAllocate(size_t size);
+    void SlabFree(void *object);
+
+    /* Whether the object lives in a slab, so Free/Reallocate can route it back here. */
+    bool IsSlabObject(void *object);
+    size_t SlabObjectSize(void *object);
+}
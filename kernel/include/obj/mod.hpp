@@ -8,5 +8,9 @@
 #include <stddef.h>
 
 namespace Kernel::Obj {
+    class TarObject;
+
     void HandleModuleObjects(limine_module_response *moduleStructure);
+    /* The ramdisk from the first module, nullptr if there wasn't one */
+    TarObject *GetFirstRamdisk();
 }
@@ -26,7 +26,8 @@ namespace Kernel::Obj {
         TarObject(void *RamdiskPtr);
         ~TarObject();
         File Get(const char *Path);
-        Lib::Vector<File> GetAll();
+        /* Files are only ever added while the archive is parsed, so the list needs no lock once constructed */
+        Lib::Vector<File> &GetAll();
 private:
         Lib::Vector<File> Files;
     };
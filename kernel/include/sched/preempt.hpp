@@ -0,0 +1,29 @@
+/*
+    * preempt.hpp
+    * Keeping the scheduler from switching threads
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stddef.h>
+#include <hal/cpu/smp/percpu.hpp>
+
+namespace Kernel::Sched {
+    /* Switches to another thread if the timer asked for it while preemption was disabled */
+    void PreemptPoint();
+
+    /*
+        Keeps the calling thread running on this CPU until the matching PreemptEnable,
+        interrupts still come in. Nests, and every lock but the plain test-and-set one
+        is held with preemption disabled, so a thread never sleeps holding a spinlock.
+    */
+    inline void PreemptDisable() {
+        asm volatile ("incl %%gs:%c0" : : "i"(offsetof(CPU::CPUData, PreemptCount)) : "memory");
+    }
+
+    inline void PreemptEnable() {
+        asm volatile ("decl %%gs:%c0" : : "i"(offsetof(CPU::CPUData, PreemptCount)) : "memory");
+
+        CPU::CPUData *cpu = CPU::ThisCPU();
+        if (cpu->NeedResched && !cpu->PreemptCount) PreemptPoint();
+    }
+}
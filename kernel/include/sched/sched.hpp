@@ -0,0 +1,101 @@
+/*
+    * sched.hpp
+    * Kernel threads and the preemptive scheduler
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <hal/cpu/interrupt/idt.hpp>
+#include <sched/preempt.hpp>
+
+namespace Kernel::Sched {
+    /* Wakes an idle CPU to look for threads, or sent to ourselves to switch threads once an interrupt handler is done */
+    constexpr uint8_t RescheduleVector = 0xF1;
+
+    /* Timer ticks a thread runs for before others waiting on the same CPU get a turn */
+    constexpr size_t TimeSliceTicks = 2;
+
+    /* Affinity of a thread any CPU may run */
+    constexpr size_t AnyCPU = (size_t)-1;
+
+    enum ThreadState : uint32_t {
+        THREAD_READY,
+        THREAD_RUNNING,
+        /* Called Block and is on its way off the CPU, a Wake now makes it READY again */
+        THREAD_BLOCKING,
+        THREAD_BLOCKED,
+        THREAD_DEAD,
+    };
+
+    struct Thread {
+        /* Saved by SwitchContext while the thread isn't running */
+        uintptr_t StackPointer;
+        /* nullptr for the idle threads, which keep the stack they were started on */
+        void *StackTop;
+
+        void (*Entry)(void *);
+        void *Argument;
+        const char *Name;
+
+        ThreadState State;
+        /* Set by a Wake that came while the thread was still running, its next Block returns straight away */
+        bool WakePending;
+        /* AnyCPU, or the only CPU that may run it */
+        size_t Affinity;
+        /* Queued ahead of the other threads, for bottom halves */
+        bool Urgent;
+
+        /* Run queue link */
+        Thread *Next;
+    };
+
+    /* Sets up this CPU's run queue, with the calling context as its idle thread. Called once by every CPU from CPU::Idle. */
+    void InitializeCPU();
+
+    /*
+        Starts a kernel thread running entry(argument), on the given CPU or wherever
+        there's room. It returns into ExitThread. Returns nullptr if there's no memory.
+        An urgent thread goes to the front of the run queue whenever it's woken.
+    */
+    Thread *CreateThread(void (*entry)(void *), void *argument, const char *name, size_t cpu = AnyCPU, bool urgent = false);
+
+    Thread *GetCurrentThread();
+
+    /* Lets other threads ready on this CPU run first, does nothing before the CPU has entered Idle */
+    void Yield();
+
+    __attribute__((noreturn)) void ExitThread();
+
+    /*
+        Sleeps until another thread or an interrupt calls Wake on this one. A Wake that
+        comes in before the Block isn't lost, so a waiter can publish itself, check its
+        condition and then Block without a lock:
+
+            waiter = Sched::GetCurrentThread();
+            while (!condition) Sched::Block();
+    */
+    void Block();
+    void Wake(Thread *thread);
+
+    /*
+        For the idle threads: runs whatever is ready here or can be stolen from another
+        CPU, returning once there's nothing left. Returns whether anything ran.
+    */
+    bool RunReadyThreads();
+    /* For the idle threads: halts until an interrupt, unless a thread became ready meanwhile */
+    void IdleWait();
+
+    /* Called by every CPU's timer interrupt, after the EOI */
+    void Tick();
+    /*
+        Switches threads on this CPU at the next chance: right after the current interrupt
+        handler, or once preemption is enabled again. E.g. after waking an urgent thread.
+    */
+    void RequestResched();
+
+    /* Threads ready on a CPU, for statistics */
+    size_t GetRunQueueLength(size_t cpu);
+
+    __attribute__((interrupt)) void RescheduleInterrupt(CPU::Interrupts::CInterruptRegisters *);
+}
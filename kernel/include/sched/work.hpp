@@ -0,0 +1,45 @@
+/*
+    * work.hpp
+    * Deferred work for interrupt handlers, and a pool of worker threads
+    * Created 17/10/2026
+*/
+#pragma once
+#include <stddef.h>
+
+namespace Kernel::Sched {
+    /*
+        A piece of work to run later in a thread. It belongs to whoever queues it
+        (usually a static next to an interrupt handler), so queueing never allocates.
+        It can't be queued again until it has started running, from then on the
+        function may queue it again itself.
+    */
+    struct Work {
+        void (*Function)(void *);
+        void *Argument;
+        Work *Next = nullptr;
+        bool Pending = false;
+
+        constexpr Work(void (*function)(void *) = nullptr, void *argument = nullptr) : Function(function), Argument(argument) {}
+    };
+
+    /* Upper bound on the worker pool, machines with fewer CPUs get one worker per CPU */
+    constexpr size_t MaxWorkers = 8;
+
+    /* Starts every CPU's bottom-half thread and the worker pool, once all CPUs are up. Anything queued earlier waits until then. */
+    void InitializeWorkQueues();
+
+    /*
+        Bottom half: runs the work on this CPU, in a thread that goes ahead of every other
+        thread there, soon after the interrupt handler returns. For the short follow-up
+        of an interrupt that shouldn't hold up other interrupts. Safe to call from an
+        interrupt handler, returns false if the work is still pending.
+    */
+    bool QueueDeferred(Work *work);
+
+    /*
+        Hands the work to the worker pool, whichever CPU is idle picks it up. For heavier
+        work that doesn't have to run anywhere in particular. Safe to call from an
+        interrupt handler, returns false if the work is still pending.
+    */
+    bool QueueWork(Work *work);
+}
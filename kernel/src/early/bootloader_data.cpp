@@ -6,6 +6,9 @@
 
 #include <limine.h>
 #include <early/bootloader_data.hpp>
+#include <mm/heap.hpp>
+#include <mm/mem.hpp>
+#include <libs/kernel.hpp>
 
 static volatile struct limine_framebuffer_request framebuffer_request = {
     .id = LIMINE_FRAMEBUFFER_REQUEST,
@@ -65,4 +68,61 @@ BootloaderData GetBootloaderData()
     };
 
     return ret;
-}
\ No newline at end of file
+}
+
+/* Copies an object out of bootloader memory onto the kernel heap, panics with error if the heap is out of memory */
+template <typename T> static T *CopyObject(T *object, const char *error) {
+    if (!object) return nullptr;
+
+    T *copy = (T *)Kernel::Mem::Allocate(sizeof(T));
+    if (!copy) Kernel::Panic(error);
+
+    memcpy(copy, object, sizeof(T));
+
+    return copy;
+}
+
+template <typename T> static T **CopyArray(T **array, size_t count, const char *error) {
+    T **copy = (T **)Kernel::Mem::Allocate(sizeof(T *) * count);
+    if (!copy && count) Kernel::Panic(error);
+
+    for (size_t i = 0; i < count; i++) {
+        copy[i] = CopyObject(array[i], error);
+    }
+
+    return copy;
+}
+
+void CopyBootloaderData(BootloaderData *data)
+{
+    data->hhdm_response = CopyObject(data->hhdm_response, "[BOOT] Unable to copy the HHDM response.");
+    data->kernel_addr = CopyObject(data->kernel_addr, "[BOOT] Unable to copy the kernel address response.");
+
+    if (data->memmap) {
+        const char *error = "[BOOT] Unable to copy the memory map.";
+        limine_memmap_response *memmap = CopyObject(data->memmap, error);
+        memmap->entries = CopyArray(memmap->entries, memmap->entry_count, error);
+        data->memmap = memmap;
+    }
+
+    if (data->fbData) {
+        const char *error = "[BOOT] Unable to copy the framebuffer list.";
+        limine_framebuffer_response *fbData = CopyObject(data->fbData, error);
+        fbData->framebuffers = CopyArray(fbData->framebuffers, fbData->framebuffer_count, error);
+
+        /* Video modes and EDID data aren't used after boot */
+        for (size_t i = 0; i < fbData->framebuffer_count; i++) {
+            fbData->framebuffers[i]->edid = nullptr;
+            fbData->framebuffers[i]->edid_size = 0;
+            fbData->framebuffers[i]->modes = nullptr;
+            fbData->framebuffers[i]->mode_count = 0;
+        }
+
+        data->fbData = fbData;
+    }
+
+    /* The APs are running, ACPI tables have been copied and modules have been handled by now */
+    data->smp = nullptr;
+    data->rsdp_response = nullptr;
+    data->module_response = nullptr;
+}
@@ -8,13 +8,18 @@
 #include <terminal/terminal.hpp>
 #include <hal/cpu.hpp>
 #include <mm/pmm.hpp>
+#include <mm/numa.hpp>
 #include <hal/cpu/smp/smp.hpp>
 #include <hal/vmm.hpp>
+#include <hal/tlb.hpp>
 #include <hal/acpi.hpp>
 #include <mm/heap.hpp>
 #include <logo.h>
 #include <obj/mod.hpp>
 #include <hal/debug/serial.hpp>
+#include <hal/debug/bench.hpp>
+#include <hal/debug/lockstats.hpp>
+#include <sched/work.hpp>
 
 LIMINE_BASE_REVISION(1)
 
@@ -23,10 +28,32 @@ BootloaderData GlobalBootloaderData;
 
 using namespace Kernel;
 
+/* Kernel debug output goes to COM1. This outlives _start's stack, so it can't be a local. */
+static Debug::SerialPort KernelDebugPort;
+
+/* Continues after _start once the BSP is running on a kernel stack */
+static void KernelMain()
+{
+    /* Keep the bootloader responses we still use, then give the bootloader's memory back */
+    CopyBootloaderData(&GlobalBootloaderData);
+    Mem::ReclaimBootMemory(*GlobalBootloaderData.memmap);
+
+#ifdef KERNEL_BENCHMARKS
+    Debug::RunBenchmarks();
+#endif
+
+#ifdef KERNEL_LOCK_STATS
+    Debug::DumpLockStats(&KernelDebugPort);
+#endif
+
+    CPU::Idle();
+}
+
 /* The procedure called by the boot loader */
 extern "C" void _start()
 {
     GlobalBootloaderData = GetBootloaderData();
+    VMM::InitializeHHDM(GlobalBootloaderData.hhdm_response->offset);
 
     /* Sets up the Global Descriptor Table & Exception Handling for the BSP. */
     CPU::Initialize();
@@ -34,7 +61,7 @@ extern "C" void _start()
     /* Set up the terminal emulator */
     limine_framebuffer fb = *GlobalBootloaderData.fbData->framebuffers[0];
     Init::InitializeFlanterm((uint32_t *)fb.address, fb.width, fb.height, fb.pitch, fb.red_mask_size, fb.red_mask_shift, fb.green_mask_size, fb.green_mask_shift, fb.blue_mask_size, fb.blue_mask_shift);
-    Debug::SerialPort KernelDebugPort = Debug::SerialPort(Debug::COM1); // Get kernel debug output on COM1
+    KernelDebugPort = Debug::SerialPort(Debug::COM1); // Get kernel debug output on COM1
 
     Init::SetSerialOutputPort(&KernelDebugPort);
 
@@ -49,20 +76,26 @@ extern "C" void _start()
 
     /* Switch to the kernel's page tables */
     VMM::LoadKernelCR3();
+    VMM::InitializeTLB();
+
+    /* Set up the heap manager (ACPI keeps its copies of the tables on the heap) */
+    Mem::InitializeHeap(0x1000 * 10);
 
     /* Initialize ACPI */
     ACPI::InitializeACPI((uintptr_t)GlobalBootloaderData.rsdp_response->address);
 
-    /* Set up the heap manager */
-    Mem::InitializeHeap(0x1000 * 10);
+    /* Split physical memory into per-node zones if this is a NUMA system */
+    Mem::InitializeNUMA();
 
     /* Set up the rest of the CPU cores */
     CPU::SetupAllCPUs();
 
+    /* Bottom halves and the worker pool, interrupt handlers hand their follow-up work to these */
+    Sched::InitializeWorkQueues();
+
     /* Handle any modules passed into the kernel */
     Obj::HandleModuleObjects(GlobalBootloaderData.module_response);
 
-    while (true) {
-        CPU::Halt();
-    }
+    /* Leave the bootloader's stack behind so that its memory can be reclaimed */
+    CPU::SwitchStack(CPU::AllocateKernelStack(), KernelMain);
 }
@@ -14,6 +14,8 @@
 #include <libs/kernel.hpp>
 #include <hal/cpu/interrupt/apic.hpp>
 #include <hal/cpu.hpp>
+#include <mm/heap.hpp>
+#include <hal/rwlock.hpp>
 
 using Kernel::ACPI::SDTHeader;
 using Kernel::ACPI::FADTStructure;
@@ -51,15 +53,16 @@ SDTHeader *MemoryMapACPITable(SDTHeader *tableHeader) {
     uintptr_t tableHeaderPhys = (uintptr_t)tableHeader;
     
     /* Now we map only the header, so we know the length of the whole table */
-    for (uintptr_t i = ALIGN_DOWN((uintptr_t)tableHeader, 0x1000); i < (uintptr_t)tableHeader + sizeof(SDTHeader); i += 0x1000) {
-        Kernel::VMM::MemoryMap(nullptr, hhdm_base + i, i, false);
-    }
+    uintptr_t base = ALIGN_DOWN(tableHeaderPhys, 0x1000);
+    uintptr_t end = ALIGN_UP(tableHeaderPhys + sizeof(SDTHeader), 0x1000);
+    Kernel::VMM::MapError error = Kernel::VMM::MapRange(nullptr, hhdm_base + base, base, end - base, Kernel::VMM::MAP_WRITE);
+    if (error != Kernel::VMM::MAP_OK) return nullptr;
 
     /* Now that the know the length, we map the whole table */
     tableHeader = (SDTHeader *)((uintptr_t)tableHeader + hhdm_base);
-    for (uintptr_t i = ALIGN_DOWN((uintptr_t)tableHeaderPhys, 0x1000); i < (uintptr_t)tableHeaderPhys + tableHeader->Length; i += 0x1000) {
-        Kernel::VMM::MemoryMap(nullptr, hhdm_base + i, i, false);
-    }
+    end = ALIGN_UP(tableHeaderPhys + tableHeader->Length, 0x1000);
+    error = Kernel::VMM::MapRange(nullptr, hhdm_base + base, base, end - base, Kernel::VMM::MAP_WRITE);
+    if (error != Kernel::VMM::MAP_OK) return nullptr;
 
     /* Return the higher half mapped table pointer */
     return tableHeader;
@@ -67,6 +70,14 @@ SDTHeader *MemoryMapACPITable(SDTHeader *tableHeader) {
 
 SDTHeader *GlobalRSDT = nullptr;
 
+/*
+    Every table the RSDT points to is copied onto the heap once, so lookups don't
+    remap anything and the ACPI reclaimable memory can be handed back to the PMM.
+*/
+SDTHeader **ACPITables = nullptr;
+uint32_t ACPITableCount = 0;
+Kernel::RWLock ACPITablesLock("ACPI tables");
+
 namespace Kernel::ACPI {
     void SetRSDP(uintptr_t rsdp) {
         RSDP *SystemRSDP = (RSDP *)rsdp;
@@ -75,6 +86,7 @@ namespace Kernel::ACPI {
 
         /* Map the RSDT into virtual memory */
         GlobalRSDT = MemoryMapACPITable(GlobalRSDT);
+        if (!GlobalRSDT) Panic("[ACPI] Unable to map the RSDT.");
 
         /* Ensure the RSDT passes its checksum */
         if (!SDTChecksum(GlobalRSDT)) {
@@ -82,14 +94,15 @@ namespace Kernel::ACPI {
         }
     }
 
-    SDTHeader *GetACPITable(const char *Signature) {
-        if (!GlobalRSDT) return nullptr;
-
+    void CopyACPITables() {
         /* First, we get the number of table entries in the RSDT. */
         uint32_t entryCount = (GlobalRSDT->Length - sizeof(SDTHeader)) / 4;
         /* Now, we skip over the header and start from the actual table. */
         uintptr_t RSDTTableStart = (uintptr_t)GlobalRSDT + 36; // 36 is the byte offset from the header, where the table entries start.
 
+        SDTHeader **tables = (SDTHeader **)Mem::Allocate(sizeof(SDTHeader *) * entryCount);
+        if (!tables) Panic("[ACPI] Unable to allocate memory for ACPI tables.");
+
         /* Loop through each entry in the table */
         for (uint32_t i = 0; i < entryCount; i++) {
             /* Get the actual entry */
@@ -100,15 +113,39 @@ namespace Kernel::ACPI {
             SDTHeader *header = (SDTHeader *)(uintptr_t)*entryPtr;
             /* Map it into virtual memory */
             header = MemoryMapACPITable(header);
+            if (!header) Panic("[ACPI] Unable to map an ACPI table.");
+
+            SDTHeader *copy = (SDTHeader *)Mem::Allocate(header->Length);
+            if (!copy) Panic("[ACPI] Unable to allocate memory for ACPI tables.");
 
+            memcpy(copy, header, header->Length);
+            tables[i] = copy;
+        }
+
+        ACPITablesLock.AquireWrite();
+        ACPITables = tables;
+        ACPITableCount = entryCount;
+        ACPITablesLock.ReleaseWrite();
+
+        /* Nothing should reach into the firmware's copy of the tables from here on */
+        GlobalRSDT = nullptr;
+    }
+
+    SDTHeader *GetACPITable(const char *Signature) {
+        SDTHeader *table = nullptr;
+
+        ACPITablesLock.AquireRead();
+        for (uint32_t i = 0; i < ACPITableCount; i++) {
             /* Check the signature, and if it matches, return it. */
-            if (strncmp(Signature, (const char*)header->Signature, 4) == 0) {
-                return header;
+            if (strncmp(Signature, (const char*)ACPITables[i]->Signature, 4) == 0) {
+                table = ACPITables[i];
+                break;
             }
         }
+        ACPITablesLock.ReleaseRead();
 
-        /* The table wasn't found :-( */
-        return nullptr;
+        /* nullptr if the table wasn't found :-( */
+        return table;
     }
 
     /* Fixed rate of the PMT, at 3.579545 MHz */
@@ -138,6 +175,9 @@ namespace Kernel::ACPI {
     void InitializeACPI(uintptr_t rsdp) {
         /* Set the global RSDP */
         SetRSDP(rsdp);
+
+        /* Take our own copy of every table */
+        CopyACPITables();
         
         /* Get the FADT */
         GlobalFADT = (FADTStructure *)GetACPITable("FACP");
@@ -203,9 +243,8 @@ namespace Kernel::ACPI {
         switch (GlobalFADT->ResetReg.AddressSpace) {
             case GenericAddressStructure::GAS_TYPE_MMIO: { // System memory space
                 // Make sure the memory is mapped
-                for (uintptr_t i = ALIGN_DOWN(GlobalFADT->ResetReg.Address, 4096); i < GlobalFADT->ResetReg.Address + 1; i += 4096) {
-                    VMM::MemoryMap(nullptr, i, i, false);
-                }
+                uintptr_t page = ALIGN_DOWN(GlobalFADT->ResetReg.Address, 4096);
+                if (VMM::MapRange(nullptr, page, page, 4096, VMM::MAP_WRITE | VMM::MAP_CACHE_UC) != VMM::MAP_OK) return false;
 
                 uint8_t *reset = (uint8_t *)GlobalFADT->ResetReg.Address;
                 *reset = GlobalFADT->ResetValue; // System will reset now!
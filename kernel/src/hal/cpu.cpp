@@ -7,13 +7,84 @@
 #include <hal/cpu/gdt.hpp>
 #include <hal/cpu/interrupt/idt.hpp>
 #include <hal/cpu.hpp>
+#include <hal/fpu.hpp>
+#include <hal/vmm.hpp>
+#include <hal/cpu/smp/percpu.hpp>
+#include <mm/pmm.hpp>
+#include <libs/kernel.hpp>
+#include <libs/cpuid.hpp>
+
+constexpr uint32_t IA32_PAT = 0x277;
+
+enum PATMemoryType : uint64_t {
+    PAT_UC = 0x00,
+    PAT_WC = 0x01,
+    PAT_WT = 0x04,
+    PAT_WP = 0x05,
+    PAT_WB = 0x06,
+    PAT_UC_MINUS = 0x07,
+};
 
 namespace Kernel::CPU {
+    void InitializePAT() {
+        uint32_t eax, ebx, ecx, edx;
+        Kernel::Cpuid(1, &eax, &ebx, &ecx, &edx);
+        if (!(edx & (1 << 16))) return;
+
+        uint64_t pat = PAT_WB | PAT_WC << 8 | PAT_UC_MINUS << 16 | PAT_UC << 24 |
+            PAT_WB << 32 | PAT_WP << 40 | PAT_UC_MINUS << 48 | PAT_WT << 56;
+
+        /* Nothing may be cached or in the TLB under the old memory types */
+        uint64_t flags = SaveAndDisableInterrupts();
+        asm volatile ("wbinvd" : : : "memory");
+        WriteMSR(IA32_PAT, pat);
+        asm volatile ("wbinvd" : : : "memory");
+        WriteCR3(ReadCR3());
+        RestoreInterrupts(flags);
+    }
+
     void Initialize() {
+        LoadCPUData(nullptr);
+        InitializeFPU();
+        InitializePAT();
         GDT::Load();
         Interrupts::Initialize();
         Interrupts::Install();
     }
+
+    void *TryAllocateKernelStack() {
+        void *stack = Mem::AllocatePages(Mem::PageOrder(KernelStackSize / 0x1000), Mem::PAGE_ALLOC_NO_ZERO);
+        if (!stack) return nullptr;
+
+        Mem::SetPageOwner(stack, Mem::PAGE_OWNER_STACK);
+
+        return (void *)(HHDMPhysToVirt((uintptr_t)stack) + KernelStackSize);
+    }
+
+    void *AllocateKernelStack() {
+        void *stackTop = TryAllocateKernelStack();
+        if (!stackTop) Panic("Unable to allocate a kernel stack.");
+
+        return stackTop;
+    }
+
+    void FreeKernelStack(void *stackTop) {
+        if (!stackTop) return;
+
+        Mem::FreePages((void *)HHDMVirtToPhys((uintptr_t)stackTop - KernelStackSize), Mem::PageOrder(KernelStackSize / 0x1000));
+    }
+
+    __attribute__((noreturn)) void SwitchStack(void *stackTop, void (*target)()) {
+        asm volatile (
+            "mov %0, %%rsp\n"
+            "xor %%ebp, %%ebp\n"
+            "call *%1\n"
+            "ud2\n"
+            : : "r"(stackTop), "r"(target) : "memory"
+        );
+
+        __builtin_unreachable();
+    }
 }
 
 /* For C code */
@@ -5,6 +5,7 @@
 */
 
 #include <hal/cpu/gdt.hpp>
+#include <hal/cpu.hpp>
 
 using namespace Kernel::CPU::GDT;
 
@@ -21,8 +22,13 @@ GDTR GDTPtr = {
     .Addr = (uintptr_t)&GDT
 };
 
+constexpr uint32_t IA32_GS_BASE = 0xC0000101;
+
 void InstallGDT() {
+    /* Reloading GS clears its base, which points at the per-CPU data by now */
+    uint64_t gsBase = Kernel::CPU::ReadMSR(IA32_GS_BASE);
     LoadGDT(&GDTPtr); 
+    Kernel::CPU::WriteMSR(IA32_GS_BASE, gsBase);
 }
 
 namespace Kernel::CPU::GDT {
@@ -13,11 +13,19 @@
 #include <libs/cpuid.hpp>
 #include <early/bootloader_data.hpp>
 #include <hal/cpu/interrupt/idt.hpp>
+#include <hal/rwlock.hpp>
+#include <hal/cpu.hpp>
 
 extern BootloaderData GlobalBootloaderData;
 
 constexpr size_t APIC_TMR_MASKED = 0x10000;
 constexpr size_t APIC_TMR_MODE_PERIODIC = 0x20000;
+constexpr uint32_t APIC_ICR_LEVEL_ASSERT = 0x4000;
+constexpr uint32_t APIC_ICR_PENDING = 0x1000;
+/* Destination shorthands, the ICR's destination field is ignored with these */
+constexpr uint32_t APIC_ICR_SELF = 1 << 18;
+constexpr uint32_t APIC_ICR_ALL = 2 << 18;
+constexpr uint32_t APIC_ICR_ALL_BUT_SELF = 3 << 18;
 
 uintptr_t LocalAPICBase = 0;
 
@@ -35,6 +43,9 @@ enum LAPICRegisters {
     EOI = 0xB0,
     /* Spurious interrupt register */
     Spurious = 0xF0,
+    /* Interrupt command register, writing the low half sends the IPI */
+    ICRLow = 0x300,
+    ICRHigh = 0x310,
     /* Keeps the interrupt vector number & mode for the timer. */
     LVTTimer = 0x320,
     /* Timer's divisor */
@@ -47,6 +58,7 @@ enum LAPICRegisters {
 
 /* Interrupt source override structures */
 Kernel::Lib::Vector<InterruptControllerStructure *> *GlobalISOStructures;
+Kernel::RWLock GlobalISOLock("ISO structures");
 
 // 
 // IOAPIC class
@@ -152,6 +164,7 @@ public:
 
     void CreateRedirectionEntry(RedirectionEntry redirEntry, int irq) {
         /* Register an IRQ taking into account Interrupt Source Overrides */
+        GlobalISOLock.AquireRead();
         for (size_t i = 0; i < GlobalISOStructures->size(); i++) {
             InterruptSourceOverride *iso = (InterruptSourceOverride *)GlobalISOStructures->at(i);
 
@@ -160,6 +173,8 @@ public:
                 irq = iso->GSI;
             }
         }
+        GlobalISOLock.ReleaseRead();
+
         WriteRedirectionEntry(irq * 2, redirEntry);
     }
 };
@@ -201,7 +216,8 @@ namespace Kernel::CPU {
         LocalAPICBase = GlobalMADT->LAPICAddress + GlobalBootloaderData.hhdm_response->offset;
 
         /* Map the Local APIC base into virtual memory so CPUs can access their APIC data */
-        VMM::MemoryMap(nullptr, LocalAPICBase, (uintptr_t)GlobalMADT->LAPICAddress, false);
+        VMM::MapError error = VMM::MapRange(nullptr, LocalAPICBase, (uintptr_t)GlobalMADT->LAPICAddress, 0x1000, VMM::MAP_WRITE | VMM::MAP_CACHE_UC);
+        if (error != VMM::MAP_OK) Panic("[APIC] Unable to map the Local APIC.");
     }
     
     void FindAllInterruptControllers(Lib::Vector<InterruptControllerStructure *> *vec, uint8_t Type) {
@@ -235,15 +251,20 @@ namespace Kernel::CPU {
         InterruptControllerStructure *ioapic_structure = ioapic_vec.at(0);
 
         /* Set up a vector containing interrupt source overrides*/
-        GlobalISOStructures = new Lib::Vector<InterruptControllerStructure *>();
-        FindAllInterruptControllers(GlobalISOStructures, 0x2);
+        Lib::Vector<InterruptControllerStructure *> *isoStructures = new Lib::Vector<InterruptControllerStructure *>();
+        FindAllInterruptControllers(isoStructures, 0x2);
+
+        GlobalISOLock.AquireWrite();
+        GlobalISOStructures = isoStructures;
+        GlobalISOLock.ReleaseWrite();
         
         /* Set up a new I/O APIC object from our first I/O APIC */
         GlobalIOAPIC = new IOAPIC((void *)ioapic_structure);
 
         /* Map the I/O APIC base into the higher half*/
         uintptr_t ioapic_base = GlobalIOAPIC->GetIOAPICBase();
-        VMM::MemoryMap(nullptr, ioapic_base + hhdm_base, ioapic_base, false);
+        VMM::MapError error = VMM::MapRange(nullptr, ALIGN_DOWN(ioapic_base + hhdm_base, 0x1000), ALIGN_DOWN(ioapic_base, 0x1000), 0x1000, VMM::MAP_WRITE | VMM::MAP_CACHE_UC);
+        if (error != VMM::MAP_OK) Panic("[APIC] Unable to map the I/O APIC.");
 
         /* Now set the MMIO address to use the HHDM mapping */
         GlobalIOAPIC->SetIOAPICBase(ioapic_base + hhdm_base);
@@ -279,16 +300,40 @@ namespace Kernel::CPU {
         /* Set up our freshly calibrated data */
         GlobalTimerFlags.LVTRegister = 0x20 | APIC_TMR_MODE_PERIODIC;
         GlobalTimerFlags.DivisorRegister = 0x3;
-        GlobalTimerFlags.InitCountRegister = calibration;
+        GlobalTimerFlags.InitCountRegister = (uint64_t)calibration * 20 / TimerFrequency; // calibration counted for 1/20 of a second
 
         /* Report success */
         return true;
     }
 
-    uint32_t GetApicId() {
-        uint32_t val = LAPICRead((void *)LocalAPICBase, LAPIC_ID);
-        uint8_t ID = (val >> 24) & 0xFF;
+    /* Writing the low half sends the IPI, so it goes last */
+    static void WriteICR(uint32_t high, uint32_t low) {
+        uint64_t flags = SaveAndDisableInterrupts();
+
+        /* Wait for the previous IPI from this CPU to be accepted */
+        while (LAPICRead((void *)LocalAPICBase, ICRLow) & APIC_ICR_PENDING) Pause();
+
+        LAPICWrite((void *)LocalAPICBase, ICRHigh, high);
+        LAPICWrite((void *)LocalAPICBase, ICRLow, low);
+
+        RestoreInterrupts(flags);
+    }
 
-        return ID;
+    void SendIPI(uint32_t apicId, uint8_t vector) {
+        /* Fixed delivery, physical destination */
+        WriteICR(apicId << 24, vector | APIC_ICR_LEVEL_ASSERT);
+    }
+
+    void SendIPISelf(uint8_t vector) {
+        WriteICR(0, vector | APIC_ICR_LEVEL_ASSERT | APIC_ICR_SELF);
+    }
+
+    void BroadcastIPI(uint8_t vector, bool includeSelf) {
+        WriteICR(0, vector | APIC_ICR_LEVEL_ASSERT | (includeSelf ? APIC_ICR_ALL : APIC_ICR_ALL_BUT_SELF));
+    }
+
+    uint32_t GetApicId() {
+        /* Recorded in the per-CPU block when the CPU came up, no LAPIC register read needed */
+        return ThisCPU()->ApicId;
     }
 }
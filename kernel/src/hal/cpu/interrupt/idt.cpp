@@ -10,6 +10,11 @@
 #include <hal/cpu/interrupt/apic.hpp>
 #include <libs/kernel.hpp>
 #include <hal/cpu/smp/smp.hpp>
+#include <hal/tlb.hpp>
+#include <hal/cpu/smp/call.hpp>
+#include <hal/rwlock.hpp>
+#include <sched/sched.hpp>
+#include <sched/work.hpp>
 
 using namespace Kernel::CPU;
 
@@ -34,24 +39,57 @@ __attribute__((interrupt)) void ExceptionHandler2(Interrupts::CInterruptRegister
     }
 }
 
+/* Read far more often than the BSP's timer updates it */
+struct TimerClock {
+    volatile size_t Ticks;
+    volatile uint64_t LastTickTSC;
+};
+
+static TimerClock Clock;
+static Kernel::SeqLock ClockLock;
+
 __attribute__((interrupt)) void TimerInterrupt(Interrupts::CInterruptRegisters *) {
+    /* Every CPU's LAPIC timer runs at the same rate, only one of them keeps time */
+    if (GetCPUIndex() == 0) {
+        ClockLock.WriteBegin();
+        Clock.Ticks = Clock.Ticks + 1;
+        Clock.LastTickTSC = ReadTSC();
+        ClockLock.WriteEnd();
+    }
+
     TimerReset();
     LAPIC_EOI();
+
+    /* May switch to another thread, this one continues here once it's picked again */
+    Kernel::Sched::Tick();
 }
 
 constexpr uint8_t DeleteScancode = 0x53;
 constexpr uint8_t EscapeScancode = 0x01;
 bool DeletePressed = false;
+
+/* The keyboard handler only reads the scancode, printing and rebooting happen later in a thread */
+static void AnnounceReboot(void *) {
+    Kernel::Log(KERNEL_LOG_DEBUG, "[ACPI Debug] Press Escape to reboot the PC using ACPI.\n");
+}
+
+static void Reboot(void *) {
+    if (!Kernel::ACPI::PerformACPIReboot()) Kernel::Log(KERNEL_LOG_FAIL, "Unable to perform ACPI reboot.\n");
+}
+
+static Kernel::Sched::Work AnnounceRebootWork(AnnounceReboot);
+static Kernel::Sched::Work RebootWork(Reboot);
+
 __attribute__((interrupt)) void KeyboardInterrupt(Interrupts::CInterruptRegisters *) {
     uint8_t scan = Kernel::IO::inb(0x60);
 
     if (scan == DeleteScancode) {
-        Kernel::Log(KERNEL_LOG_DEBUG, "[ACPI Debug] Press Escape to reboot the PC using ACPI.\n");
+        Kernel::Sched::QueueDeferred(&AnnounceRebootWork);
         DeletePressed = true;
     }
 
     if (scan == EscapeScancode && DeletePressed) {
-        if (!Kernel::ACPI::PerformACPIReboot()) Kernel::Log(KERNEL_LOG_FAIL, "Unable to perform ACPI reboot.\n");
+        Kernel::Sched::QueueWork(&RebootWork);
     }
 
     LAPIC_EOI();
@@ -95,6 +133,9 @@ namespace Kernel::CPU::Interrupts {
 
         CreateIDTEntry(0x20, (void *)TimerInterrupt, 0x8E);
         CreateIDTEntry(0x21, (void *)KeyboardInterrupt, 0x8E);
+        CreateIDTEntry(VMM::TLBShootdownVector, (void *)VMM::TLBShootdownInterrupt, 0x8E);
+        CreateIDTEntry(Sched::RescheduleVector, (void *)Sched::RescheduleInterrupt, 0x8E);
+        CreateIDTEntry(CallFunctionVector, (void *)CallFunctionInterrupt, 0x8E);
 
         /* Now we setup the IDTR */
         IDTPtr.Limit = 0xfff;
@@ -107,6 +148,30 @@ namespace Kernel::CPU::Interrupts {
         // Note: Not sure how common/frequent this is, or if it happens at all with modern PCs.
     }
 
+    void ResetTimerTicks() {
+        uint64_t flags = SaveAndDisableInterrupts();
+        ClockLock.WriteBegin();
+        Clock.Ticks = 0;
+        Clock.LastTickTSC = ReadTSC();
+        ClockLock.WriteEnd();
+        RestoreInterrupts(flags);
+    }
+
+    size_t GetTimerTicks(uint64_t *lastTickTSC) {
+        size_t ticks;
+        uint64_t tsc;
+
+        uint32_t sequence;
+        do {
+            sequence = ClockLock.ReadBegin();
+            ticks = Clock.Ticks;
+            tsc = Clock.LastTickTSC;
+        } while (ClockLock.ReadRetry(sequence));
+
+        if (lastTickTSC) *lastTickTSC = tsc;
+        return ticks;
+    }
+
     void Install() {
         /* Load IDT and enable interrupts */
         asm ("lidt %0" : : "m" (IDTPtr));
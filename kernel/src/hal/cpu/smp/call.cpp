@@ -0,0 +1,147 @@
+/*
+    * call.cpp
+    * Running functions on other CPUs through IPIs
+    * Created 17/10/2026
+*/
+
+#include <hal/cpu/smp/call.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <hal/cpu/interrupt/apic.hpp>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/tlb.hpp>
+#include <libs/kernel.hpp>
+
+struct CallEntry {
+    void (*Function)(void *);
+    void *Argument;
+    /* The caller's count of CPUs still to run it, nullptr if it doesn't wait */
+    volatile size_t *Remaining;
+};
+
+/*
+    A ring of calls for one CPU. Callers copy their entry in, so one that doesn't
+    wait can return straight away. Only taken with interrupts disabled.
+*/
+struct CallQueue {
+    volatile bool Lock;
+    /* An IPI was sent that the CPU hasn't handled yet, later callers don't need to send another */
+    bool IPIPending;
+    size_t Head;
+    size_t Tail;
+    CallEntry Entries[Kernel::CPU::CallQueueSize];
+};
+
+static PERCPU_CREATE(CallQueue, CallQueues);
+
+namespace Kernel::CPU {
+    /* Queues the entry for a CPU and returns whether it needs an IPI, waits while its queue is full */
+    static bool QueueCall(size_t cpu, const CallEntry &entry) {
+        CallQueue *queue = &CallQueues[cpu];
+
+        while (true) {
+            SpinlockAquire(&queue->Lock);
+
+            if (queue->Tail - queue->Head < CallQueueSize) {
+                queue->Entries[queue->Tail++ % CallQueueSize] = entry;
+
+                bool sendIPI = !queue->IPIPending;
+                queue->IPIPending = true;
+
+                SpinlockRelease(&queue->Lock);
+                return sendIPI;
+            }
+
+            SpinlockRelease(&queue->Lock);
+
+            /* It may be waiting on us to make room */
+            ServiceCallQueue();
+            VMM::ServiceTLBShootdowns();
+            Pause();
+        }
+    }
+
+    size_t SmpCallFunction(CPUMask mask, void (*function)(void *), void *argument, bool wait) {
+        /* Also keeps us from moving to another CPU half way through */
+        uint64_t flags = SaveAndDisableInterrupts();
+        if (wait && !(flags & (1 << 9))) Panic("[SMP] SmpCallFunction waiting with interrupts disabled.");
+
+        size_t self = GetCPUIndex();
+        size_t count = GetCPUCount() ? GetCPUCount() : 1;
+        volatile size_t remaining = 0;
+
+        CallEntry entry = { function, argument, wait ? &remaining : nullptr };
+        CPUMask targets = 0;
+
+        for (size_t cpu = 0; cpu < count; cpu++) {
+            if (cpu == self || !(mask & CPUMaskOf(cpu)) || !IsCPUOnline(cpu)) continue;
+
+            targets |= CPUMaskOf(cpu);
+            remaining = remaining + 1;
+        }
+
+        /* Everything has to be queued before anyone can finish and count down */
+        size_t called = remaining;
+        CPUMask needIPI = 0;
+        for (size_t cpu = 0; cpu < count; cpu++) {
+            if ((targets & CPUMaskOf(cpu)) && QueueCall(cpu, entry)) needIPI |= CPUMaskOf(cpu);
+        }
+
+        /* One ICR write instead of one per CPU, when every other CPU is being called and none were left out at boot */
+        bool broadcast = needIPI && count < MaxCPUCount && needIPI == ((CPUMaskOf(count) - 1) & ~CPUMaskOf(self));
+        if (broadcast) {
+            BroadcastIPI(CallFunctionVector);
+        } else {
+            for (size_t cpu = 0; cpu < count; cpu++) {
+                if (needIPI & CPUMaskOf(cpu)) SendIPI(GetCPUApicId(cpu), CallFunctionVector);
+            }
+        }
+
+        /* Our own share runs while the others take their interrupts */
+        if (mask & CPUMaskOf(self)) {
+            function(argument);
+            called++;
+        }
+
+        /* Keep servicing our own queues while waiting, a CPU waiting on us would deadlock otherwise */
+        if (wait) {
+            while (__atomic_load_n(&remaining, __ATOMIC_ACQUIRE)) {
+                ServiceCallQueue();
+                VMM::ServiceTLBShootdowns();
+                Pause();
+            }
+        }
+
+        RestoreInterrupts(flags);
+        return called;
+    }
+
+    void ServiceCallQueue() {
+        uint64_t flags = SaveAndDisableInterrupts();
+        CallQueue *queue = &CallQueues.Local();
+
+        while (true) {
+            SpinlockAquire(&queue->Lock);
+
+            if (queue->Head == queue->Tail) {
+                /* Anything queued from now on comes with a new IPI */
+                queue->IPIPending = false;
+                SpinlockRelease(&queue->Lock);
+                break;
+            }
+
+            CallEntry entry = queue->Entries[queue->Head++ % CallQueueSize];
+            SpinlockRelease(&queue->Lock);
+
+            entry.Function(entry.Argument);
+            if (entry.Remaining) __atomic_fetch_sub(entry.Remaining, 1, __ATOMIC_RELEASE);
+        }
+
+        RestoreInterrupts(flags);
+    }
+
+    __attribute__((interrupt)) void CallFunctionInterrupt(Interrupts::CInterruptRegisters *) {
+        ServiceCallQueue();
+        LAPIC_EOI();
+    }
+}
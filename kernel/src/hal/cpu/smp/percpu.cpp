@@ -0,0 +1,56 @@
+/*
+    * percpu.cpp
+    * Per-CPU data, reached through the GS base
+    * Created 17/10/2026
+*/
+
+#include <hal/cpu/smp/percpu.hpp>
+#include <hal/cpu.hpp>
+#include <hal/vmm.hpp>
+#include <mm/pmm.hpp>
+#include <libs/kernel.hpp>
+#include <libs/cpuid.hpp>
+
+constexpr uint32_t IA32_GS_BASE = 0xC0000101;
+constexpr uint32_t IA32_KERNEL_GS_BASE = 0xC0000102;
+
+static_assert(sizeof(Kernel::CPU::CPUData) <= 0x1000, "CPUData should fit in a page");
+
+/* The BSP's block, usable before there's any memory management */
+static Kernel::CPU::CPUData BootCPUData = { &BootCPUData, 0, 0, 0, false, nullptr };
+static Kernel::CPU::CPUData *CPUDataBlocks[Kernel::CPU::MaxCPUCount] = { &BootCPUData };
+
+namespace Kernel::CPU {
+    void LoadCPUData(CPUData *data) {
+        if (!data) {
+            /* The LAPIC isn't mapped yet, CPUID has the initial APIC ID too */
+            uint32_t eax, ebx, ecx, edx;
+            Cpuid(1, &eax, &ebx, &ecx, &edx);
+
+            data = &BootCPUData;
+            data->ApicId = ebx >> 24;
+        }
+
+        WriteMSR(IA32_GS_BASE, (uint64_t)data);
+        WriteMSR(IA32_KERNEL_GS_BASE, (uint64_t)data);
+    }
+
+    CPUData *CreateCPUData(size_t index, uint32_t apicId) {
+        if (index >= MaxCPUCount) return nullptr;
+
+        CPUData *data = CPUDataBlocks[index];
+        if (!data) {
+            void *page = Mem::AllocatePage();
+            if (!page) Panic("[SMP] Unable to allocate per-CPU data.");
+
+            data = (CPUData *)HHDMPhysToVirt((uintptr_t)page);
+            CPUDataBlocks[index] = data;
+        }
+
+        data->Self = data;
+        data->Index = index;
+        data->ApicId = apicId;
+
+        return data;
+    }
+}
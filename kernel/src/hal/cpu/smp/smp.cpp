@@ -16,36 +16,110 @@
 #include <early/bootloader_data.hpp>
 #include <hal/cpu/interrupt/apic.hpp>
 #include <hal/vmm.hpp>
+#include <hal/tlb.hpp>
+#include <hal/fpu.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <mm/pmm.hpp>
+#include <mm/numa.hpp>
+#include <sched/sched.hpp>
 
 limine_smp_info *SMPData = nullptr;
 size_t CoreCount = 0;
-size_t CoresInitialized = 1; // 1 == BSP
+volatile size_t CoresInitialized = 1; // 1 == BSP
+
+static uint32_t IndexToLAPIC[Kernel::CPU::MaxCPUCount];
+static bool CPUOnline[Kernel::CPU::MaxCPUCount];
+
+/* Work handed to each CPU through RunOnCPU, Function is cleared once it has run */
+struct CPUWork {
+    void (*volatile Function)(void *);
+    void *volatile Argument;
+}__attribute__((aligned(64)));
+
+static PERCPU_CREATE(CPUWork, PendingWork);
 
 extern BootloaderData GlobalBootloaderData;
 
 namespace Kernel::CPU {
     void CPUJump(uint32_t Core, void* Target) {
-        if (!Core) return; // CPU must be > 0
         if (!SMPData) return;
+        if (SMPData[Core].lapic_id == GlobalBootloaderData.smp->bsp_lapic_id) return; // Not the BSP, which needn't be entry 0
 
         // An atomic write of a memory address to the "goto_address" field causes the CPU to jump to that address. (Limine spec.)
         SMPData[Core].goto_address = (limine_goto_address)Target;
     }
 
+    size_t GetCPUCount() {
+        return CoreCount;
+    }
+
+    uint32_t GetCPUApicId(size_t index) {
+        return IndexToLAPIC[index];
+    }
+
+    bool IsCPUOnline(size_t index) {
+        return __atomic_load_n(&CPUOnline[index], __ATOMIC_SEQ_CST);
+    }
+
+    bool RunOnCPU(size_t index, void (*function)(void *), void *argument) {
+        if (index >= CoreCount || PendingWork[index].Function) return false;
+
+        PendingWork[index].Argument = argument;
+        __atomic_store_n(&PendingWork[index].Function, function, __ATOMIC_RELEASE);
+
+        /* Wake it up if it's halted, instead of leaving the work until its next timer tick */
+        if (index != GetCPUIndex() && IsCPUOnline(index)) SendIPI(GetCPUApicId(index), Sched::RescheduleVector);
+
+        return true;
+    }
+
+    __attribute__((noreturn)) void Idle() {
+        /* This context becomes the CPU's idle thread, which only runs when no other thread is ready */
+        Sched::InitializeCPU();
+
+        CPUWork *work = &PendingWork.Local();
+
+        /* Idle: run handed over work and ready threads, spend spare cycles pre-zeroing pages, sleep until the next interrupt once there's nothing left */
+        while (true) {
+            void (*function)(void *) = __atomic_load_n(&work->Function, __ATOMIC_ACQUIRE);
+            if (function) {
+                function(work->Argument);
+                __atomic_store_n(&work->Function, nullptr, __ATOMIC_RELEASE);
+                continue;
+            }
+
+            if (Sched::RunReadyThreads()) continue;
+
+            if (!Mem::FillZeroedPagePool()) Sched::IdleWait();
+        }
+    }
+
+    /* Runs on the CPU's own kernel stack, the bootloader's stack is reclaimed once every CPU gets here */
+    void CPUIdle() {
+        __atomic_fetch_add(&CoresInitialized, 1, __ATOMIC_RELEASE);
+
+        Idle();
+    }
+
     /* Per-CPU setup: The initialization code run on each CPU as they are brought online */
-    void CPUStartPayload(limine_smp_info *CPUData) {
+    void CPUStartPayload(limine_smp_info *smpInfo) {
+        /* Everything below may look up per-CPU state */
+        LoadCPUData((CPUData *)smpInfo->extra_argument);
+
+        CPU::InitializeFPU();
+        CPU::InitializePAT();
         CPU::GDT::Load();
         CPU::Interrupts::Install();
         CPU::InitializeLAPIC();
-        VMM::LoadKernelCR3();
 
-        Log(KERNEL_LOG_SUCCESS, "[SMP Stage 3] CPU %d is online and waiting for interrupts.\n", CPUData->processor_id + 1);
+        /* Online before the CR3 load, so no page table change can slip between the two unseen */
+        __atomic_store_n(&CPUOnline[GetCPUIndex()], true, __ATOMIC_SEQ_CST);
+        VMM::LoadKernelCR3();
+        VMM::InitializeTLB();
 
-        CoresInitialized++;
+        Log(KERNEL_LOG_SUCCESS, "[SMP Stage 3] CPU %d is online and waiting for interrupts.\n", smpInfo->processor_id + 1);
 
-        while (true) {
-            CPU::Halt();
-        }
+        CPU::SwitchStack(CPU::AllocateKernelStack(), CPUIdle);
     }
 
     void SetupAllCPUs() {
@@ -53,11 +127,44 @@ namespace Kernel::CPU {
         if (!GlobalBootloaderData.smp) Panic("No SMP data provided by the bootloader, please ensure that the IO APIC is available.\n");
 
         SMPData = *GlobalBootloaderData.smp->cpus;
-        CoreCount = GlobalBootloaderData.smp->cpu_count;
+        size_t bootloaderCount = GlobalBootloaderData.smp->cpu_count;
+        CoreCount = bootloaderCount;
+
+        if (CoreCount > MaxCPUCount) {
+            Log(KERNEL_LOG_INFO, "[SMP Stage 1] Only using %d of %d CPUs.\n", MaxCPUCount, CoreCount);
+            CoreCount = MaxCPUCount;
+        }
 
         /* Detects if there is a MADT, sets up MADT state and panics if there is no MADT */
         CPU::InitializeMADT();
 
+        /*
+            Number the CPUs in bootloader order, except that the BSP is always index 0. The BSP
+            counts towards the cap wherever it is in the list, APs past the cap are never started.
+        */
+        size_t nextIndex = 1;
+        for (size_t i = 0; i < bootloaderCount; i++) {
+            uint32_t lapic = SMPData[i].lapic_id;
+
+            size_t index;
+            if (lapic == GlobalBootloaderData.smp->bsp_lapic_id) {
+                index = 0;
+            } else if (nextIndex < CoreCount) {
+                index = nextIndex++;
+            } else {
+                SMPData[i].extra_argument = 0;
+                continue;
+            }
+
+            IndexToLAPIC[index] = lapic;
+            Mem::RegisterCPUNode(index, lapic);
+
+            /* The AP picks its block up from the SMP info when it starts */
+            SMPData[i].extra_argument = (uint64_t)CreateCPUData(index, lapic);
+        }
+
+        CPUOnline[0] = true;
+
         Log(KERNEL_LOG_SUCCESS, "[SMP Stage 1] Calibrating Local APIC timer\n");
 
         /* Calibrate the APIC timer*/
@@ -81,8 +188,8 @@ namespace Kernel::CPU {
             /* This is a multiprocessor system */
             Log(KERNEL_LOG_SUCCESS, "[SMP Stage 3] Detected multiple CPUs, initializing them now...\n");
 
-            for (size_t i = 1; i < CoreCount; i++) {
-                CPUJump(i, (void *)CPUStartPayload);
+            for (size_t i = 0; i < bootloaderCount; i++) {
+                if (SMPData[i].extra_argument) CPUJump(i, (void *)CPUStartPayload);
             }
         }
 
@@ -97,6 +204,9 @@ namespace Kernel::CPU {
         IO::inb(0x60);
 
 
-        while (CoresInitialized < CoreCount); // Wait for all CPUs to be initialized before continuing kernel initialization.
+        while (__atomic_load_n(&CoresInitialized, __ATOMIC_ACQUIRE) < CoreCount) Pause(); // Wait for all CPUs to be initialized before continuing kernel initialization.
+
+        /* The SMP info structures are bootloader memory, they aren't needed past this point */
+        SMPData = nullptr;
     }
 }
@@ -0,0 +1,659 @@
+/*
+    * bench.cpp
+    * In-kernel benchmarks, built with make BENCHMARKS=1
+    * Created 17/10/2026
+*/
+
+#ifdef KERNEL_BENCHMARKS
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hal/debug/bench.hpp>
+#include <hal/cpu.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <hal/cpu/smp/call.hpp>
+#include <mm/heap.hpp>
+#include <mm/pmm.hpp>
+#include <mm/mem.hpp>
+#include <hal/fpu.hpp>
+#include <libs/string.hpp>
+#include <obj/mod.hpp>
+#include <obj/tar.hpp>
+#include <hal/vmm.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/rwlock.hpp>
+#include <terminal/terminal.hpp>
+#include <sched/sched.hpp>
+#include <sched/work.hpp>
+
+using namespace Kernel;
+
+/*
+    Runs the same body on several CPUs at once. Every CPU checks in and spins
+    until all of them have, so the timed sections overlap as much as possible.
+*/
+struct ParallelRun {
+    void (*Body)(size_t cpu, void *argument);
+    void *Argument;
+    volatile size_t Ready;
+    volatile size_t Done;
+    volatile bool Go;
+    uint64_t Cycles[CPU::MaxCPUCount];
+};
+
+static ParallelRun CurrentRun;
+
+static void ParallelEntry(void *) {
+    size_t cpu = CPU::GetCPUIndex();
+
+    __atomic_fetch_add(&CurrentRun.Ready, 1, __ATOMIC_ACQ_REL);
+    while (!__atomic_load_n(&CurrentRun.Go, __ATOMIC_ACQUIRE)) CPU::Pause();
+
+    uint64_t start = CPU::ReadTSC();
+    CurrentRun.Body(cpu, CurrentRun.Argument);
+    CurrentRun.Cycles[cpu] = CPU::ReadTSC() - start;
+
+    __atomic_fetch_add(&CurrentRun.Done, 1, __ATOMIC_ACQ_REL);
+}
+
+/* Runs body on CPUs 0 to cpuCount - 1 (the caller is CPU 0) and returns the slowest CPU's cycle count */
+static uint64_t RunParallel(size_t cpuCount, void (*body)(size_t cpu, void *argument), void *argument) {
+    CurrentRun.Body = body;
+    CurrentRun.Argument = argument;
+    CurrentRun.Ready = 0;
+    CurrentRun.Done = 0;
+    CurrentRun.Go = false;
+
+    for (size_t i = 1; i < cpuCount; i++) {
+        while (!CPU::RunOnCPU(i, ParallelEntry, nullptr)) CPU::Pause();
+    }
+
+    /* The other CPUs only notice their work when they wake up, start everyone together */
+    __atomic_fetch_add(&CurrentRun.Ready, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&CurrentRun.Ready, __ATOMIC_ACQUIRE) < cpuCount) CPU::Pause();
+    __atomic_store_n(&CurrentRun.Go, true, __ATOMIC_RELEASE);
+
+    uint64_t start = CPU::ReadTSC();
+    body(0, argument);
+    CurrentRun.Cycles[0] = CPU::ReadTSC() - start;
+    __atomic_fetch_add(&CurrentRun.Done, 1, __ATOMIC_ACQ_REL);
+
+    while (__atomic_load_n(&CurrentRun.Done, __ATOMIC_ACQUIRE) < cpuCount) CPU::Pause();
+
+    uint64_t slowest = 0;
+    for (size_t i = 0; i < cpuCount; i++) {
+        if (CurrentRun.Cycles[i] > slowest) slowest = CurrentRun.Cycles[i];
+    }
+
+    return slowest;
+}
+
+/*
+    PMM double frees: two buddy pages are freed lower half first, so the upper half gets
+    merged into it. Its frame still looks like an order 0 head, a second free of it has
+    to be refused anyway.
+*/
+constexpr size_t DoubleFreeSearchPages = 256;
+
+static bool CheckPageDoubleFree() {
+    static uintptr_t pages[DoubleFreeSearchPages];
+    size_t count = 0;
+    uintptr_t lower = 0;
+
+    /* Once the order 0 list runs dry, blocks get split and consecutive allocations are buddies */
+    while (count < DoubleFreeSearchPages) {
+        uintptr_t page = (uintptr_t)Mem::AllocatePages(0, Mem::PAGE_ALLOC_NO_ZERO);
+        if (!page) break;
+
+        if (count && pages[count - 1] == (page ^ 0x1000) && page > pages[count - 1]) {
+            lower = pages[--count];
+            break;
+        }
+
+        pages[count++] = page;
+    }
+
+    for (size_t i = 0; i < count; i++) Mem::FreePages((void *)pages[i], 0);
+    if (!lower) {
+        Log(KERNEL_LOG_INFO, "[BENCH] PMM double free: no pair of buddy pages found, skipped\n");
+        return true;
+    }
+
+    uintptr_t upper = lower + 0x1000;
+    bool passed = Mem::IsAllocatedBlock((void *)upper, 0);
+
+    Mem::FreePages((void *)lower, 0);
+    Mem::FreePages((void *)upper, 0);
+
+    /* Both halves are free now, either as the merged block or (if something took the lower half meanwhile) on their own */
+    if (Mem::IsAllocatedBlock((void *)upper, 0)) passed = false;
+
+    Log(KERNEL_LOG_INFO, "[BENCH] PMM double free of a merged upper buddy: %s\n", passed ? "refused" : "accepted");
+    return passed;
+}
+
+/* Heap: allocate/free pairs, small sizes hit the per-CPU magazines, large ones the locked heap */
+constexpr size_t HeapBenchIterations = 100000;
+
+static void HeapPairs(size_t, void *argument) {
+    size_t size = (size_t)argument;
+
+    for (size_t i = 0; i < HeapBenchIterations; i++) {
+        void *object = Mem::Allocate(size);
+        Mem::Free(object);
+    }
+}
+
+static void BenchHeapScaling(size_t size) {
+    for (size_t cpus = 1; cpus <= CPU::GetCPUCount(); cpus++) {
+        uint64_t cycles = RunParallel(cpus, HeapPairs, (void *)size);
+
+        Log(KERNEL_LOG_INFO, "[BENCH] Heap %d byte alloc/free, %d CPU(s): %d cycles per pair, %d pairs per million cycles in total\n",
+            size, cpus, cycles / HeapBenchIterations, (HeapBenchIterations * cpus * 1000000) / cycles);
+    }
+}
+
+/*
+    Locks: every CPU takes the same lock around a tiny critical section. Per acquisition
+    cost is the total over all CPUs, an unfair lock also shows as a big gap between the
+    first and the last CPU to get through its share.
+*/
+constexpr size_t LockBenchIterations = 20000;
+
+static SPINLOCK_CREATE(BenchFlagLock);
+static Spinlock BenchTicketLock;
+static QueuedSpinlock BenchQueuedLock;
+static volatile size_t BenchLockCounter;
+
+static void FlagLockLoop(size_t, void *) {
+    for (size_t i = 0; i < LockBenchIterations; i++) {
+        SpinlockAquire(&BenchFlagLock);
+        BenchLockCounter++;
+        SpinlockRelease(&BenchFlagLock);
+    }
+}
+
+static void TicketLockLoop(size_t, void *) {
+    for (size_t i = 0; i < LockBenchIterations; i++) {
+        BenchTicketLock.Aquire();
+        BenchLockCounter++;
+        BenchTicketLock.Release();
+    }
+}
+
+static void QueuedLockLoop(size_t, void *) {
+    for (size_t i = 0; i < LockBenchIterations; i++) {
+        BenchQueuedLock.Aquire();
+        BenchLockCounter++;
+        BenchQueuedLock.Release();
+    }
+}
+
+static void BenchLock(const char *name, void (*loop)(size_t cpu, void *argument)) {
+    for (size_t cpus = 1; cpus <= CPU::GetCPUCount(); cpus++) {
+        BenchLockCounter = 0;
+        uint64_t slowest = RunParallel(cpus, loop, nullptr);
+
+        uint64_t fastest = slowest;
+        for (size_t i = 0; i < cpus; i++) {
+            if (CurrentRun.Cycles[i] < fastest) fastest = CurrentRun.Cycles[i];
+        }
+
+        if (BenchLockCounter != LockBenchIterations * cpus) {
+            Log(KERNEL_LOG_FAIL, "[BENCH] %s lock lost updates: %d of %d\n", name, BenchLockCounter, LockBenchIterations * cpus);
+        }
+
+        Log(KERNEL_LOG_INFO, "[BENCH] %s lock, %d CPU(s): %d cycles per acquisition, first CPU done at %d%% of the last\n",
+            name, cpus, slowest / (LockBenchIterations * cpus), (fastest * 100) / (slowest ? slowest : 1));
+    }
+}
+
+/* Read locks: readers of read-mostly data, against taking a ticket lock for every read */
+static RWLock BenchRWLock;
+static volatile size_t BenchReadValue;
+
+static void ReadLockLoop(size_t, void *) {
+    for (size_t i = 0; i < LockBenchIterations; i++) {
+        BenchRWLock.AquireRead();
+        (void)BenchReadValue;
+        BenchRWLock.ReleaseRead();
+    }
+}
+
+static void TicketReadLoop(size_t, void *) {
+    for (size_t i = 0; i < LockBenchIterations; i++) {
+        BenchTicketLock.Aquire();
+        (void)BenchReadValue;
+        BenchTicketLock.Release();
+    }
+}
+
+static void BenchReadLock() {
+    for (size_t cpus = 1; cpus <= CPU::GetCPUCount(); cpus++) {
+        uint64_t rwCycles = RunParallel(cpus, ReadLockLoop, nullptr);
+        uint64_t ticketCycles = RunParallel(cpus, TicketReadLoop, nullptr);
+
+        Log(KERNEL_LOG_INFO, "[BENCH] Read lock, %d CPU(s): %d cycles per read, %d with a ticket lock\n",
+            cpus, rwCycles / LockBenchIterations, ticketCycles / LockBenchIterations);
+    }
+}
+
+/*
+    Scheduler: CPU 0 queues a batch of CPU bound threads on itself and waits for them
+    to finish. CPU 0 isn't scheduling yet, every thread has to be stolen by another
+    CPU, so the best case is a speedup of one less than the number of CPUs.
+*/
+constexpr size_t SchedBenchThreadsPerCPU = 4;
+constexpr size_t SchedBenchWork = 2000000;
+
+static volatile size_t SchedThreadsDone;
+static volatile bool SchedCPUsUsed[CPU::MaxCPUCount];
+
+static void SchedWork(void *) {
+    volatile size_t sum = 0;
+    for (size_t i = 0; i < SchedBenchWork; i++) {
+        sum = sum + i;
+        if (!(i % (SchedBenchWork / 4))) Sched::Yield();
+    }
+
+    SchedCPUsUsed[CPU::GetCPUIndex()] = true;
+    __atomic_fetch_add(&SchedThreadsDone, 1, __ATOMIC_RELEASE);
+}
+
+static void BenchScheduler() {
+    size_t cpus = CPU::GetCPUCount();
+    if (cpus < 2) {
+        Log(KERNEL_LOG_INFO, "[BENCH] Scheduler: needs a second CPU to steal the threads, skipped\n");
+        return;
+    }
+
+    /* The same work inline, for comparison */
+    uint64_t start = CPU::ReadTSC();
+    SchedWork(nullptr);
+    uint64_t single = CPU::ReadTSC() - start;
+
+    size_t threads = SchedBenchThreadsPerCPU * cpus;
+    SchedThreadsDone = 0;
+    for (size_t i = 0; i < cpus; i++) SchedCPUsUsed[i] = false;
+
+    start = CPU::ReadTSC();
+    for (size_t i = 0; i < threads; i++) {
+        if (!Sched::CreateThread(SchedWork, nullptr, "Bench")) {
+            Log(KERNEL_LOG_FAIL, "[BENCH] Scheduler: unable to create a thread\n");
+            threads = i;
+            break;
+        }
+    }
+
+    while (__atomic_load_n(&SchedThreadsDone, __ATOMIC_ACQUIRE) < threads) CPU::Pause();
+    uint64_t cycles = CPU::ReadTSC() - start;
+
+    size_t used = 0;
+    for (size_t i = 0; i < cpus; i++) used += SchedCPUsUsed[i];
+
+    Log(KERNEL_LOG_INFO, "[BENCH] Scheduler: %d threads finished on %d of %d CPUs, %d.%d%d times as fast as running them one after another\n",
+        threads, used, cpus, (single * threads) / cycles, (single * threads * 10 / cycles) % 10, (single * threads * 100 / cycles) % 10);
+}
+
+/*
+    Work queue: CPU 0 hands out a batch of small jobs to the worker pool and waits.
+    Reports how long a job waited to start, and on how many CPUs the jobs ran.
+*/
+constexpr size_t WorkBenchItems = 64;
+constexpr size_t WorkBenchSpin = 200000;
+
+static Sched::Work BenchWorkItems[WorkBenchItems];
+static uint64_t BenchWorkQueued[WorkBenchItems];
+static volatile uint64_t BenchWorkLatency;
+static volatile size_t BenchWorkDone;
+static volatile bool BenchWorkCPUs[CPU::MaxCPUCount];
+
+static void BenchWorkItem(void *argument) {
+    uint64_t latency = CPU::ReadTSC() - BenchWorkQueued[(size_t)argument];
+    __atomic_fetch_add(&BenchWorkLatency, latency, __ATOMIC_RELAXED);
+
+    volatile size_t sum = 0;
+    for (size_t i = 0; i < WorkBenchSpin; i++) sum = sum + i;
+
+    BenchWorkCPUs[CPU::GetCPUIndex()] = true;
+    __atomic_fetch_add(&BenchWorkDone, 1, __ATOMIC_RELEASE);
+}
+
+static void BenchWorkQueue() {
+    size_t cpus = CPU::GetCPUCount();
+    if (cpus < 2) {
+        Log(KERNEL_LOG_INFO, "[BENCH] Work queue: CPU 0 can't run workers while it waits, skipped\n");
+        return;
+    }
+
+    BenchWorkLatency = 0;
+    BenchWorkDone = 0;
+    for (size_t i = 0; i < cpus; i++) BenchWorkCPUs[i] = false;
+
+    uint64_t start = CPU::ReadTSC();
+    for (size_t i = 0; i < WorkBenchItems; i++) {
+        BenchWorkItems[i] = Sched::Work(BenchWorkItem, (void *)i);
+        BenchWorkQueued[i] = CPU::ReadTSC();
+        Sched::QueueWork(&BenchWorkItems[i]);
+    }
+
+    while (__atomic_load_n(&BenchWorkDone, __ATOMIC_ACQUIRE) < WorkBenchItems) CPU::Pause();
+    uint64_t cycles = CPU::ReadTSC() - start;
+
+    size_t used = 0;
+    for (size_t i = 0; i < cpus; i++) used += BenchWorkCPUs[i];
+
+    Log(KERNEL_LOG_INFO, "[BENCH] Work queue: %d jobs in %d cycles on %d of %d CPUs, %d cycles from queueing to start on average\n",
+        WorkBenchItems, cycles, used, cpus, BenchWorkLatency / WorkBenchItems);
+}
+
+/*
+    IPIs: round trips of an empty SmpCallFunction from CPU 0, waiting for the other
+    side to run it. The other CPUs sit halted in their idle threads, so this includes
+    waking them up.
+*/
+constexpr size_t IPIBenchIterations = 1000;
+
+static volatile size_t BenchIPICalls;
+
+static void BenchIPICall(void *) {
+    __atomic_fetch_add(&BenchIPICalls, 1, __ATOMIC_RELAXED);
+}
+
+static void BenchIPI() {
+    size_t cpus = CPU::GetCPUCount();
+    if (cpus < 2) {
+        Log(KERNEL_LOG_INFO, "[BENCH] IPI: there's no other CPU to send to, skipped\n");
+        return;
+    }
+
+    for (size_t cpu = 1; cpu < cpus; cpu++) {
+        BenchIPICalls = 0;
+
+        uint64_t start = CPU::ReadTSC();
+        for (size_t i = 0; i < IPIBenchIterations; i++) {
+            CPU::SmpCallFunction(CPU::CPUMaskOf(cpu), BenchIPICall, nullptr, true);
+        }
+        uint64_t cycles = CPU::ReadTSC() - start;
+
+        if (BenchIPICalls != IPIBenchIterations) {
+            Log(KERNEL_LOG_FAIL, "[BENCH] IPI to CPU %d ran %d of %d calls\n", cpu, BenchIPICalls, IPIBenchIterations);
+        }
+
+        Log(KERNEL_LOG_INFO, "[BENCH] IPI round trip to CPU %d: %d cycles\n", cpu, cycles / IPIBenchIterations);
+    }
+
+    /* Everyone but ourselves, a single broadcast IPI */
+    BenchIPICalls = 0;
+
+    uint64_t start = CPU::ReadTSC();
+    for (size_t i = 0; i < IPIBenchIterations; i++) {
+        CPU::SmpCallFunction(CPU::AllCPUs & ~CPU::CPUMaskOf(0), BenchIPICall, nullptr, true);
+    }
+    uint64_t cycles = CPU::ReadTSC() - start;
+
+    if (BenchIPICalls != IPIBenchIterations * (cpus - 1)) {
+        Log(KERNEL_LOG_FAIL, "[BENCH] IPI broadcast ran %d of %d calls\n", BenchIPICalls, IPIBenchIterations * (cpus - 1));
+    }
+
+    Log(KERNEL_LOG_INFO, "[BENCH] IPI round trip to all %d other CPUs: %d cycles\n", cpus - 1, cycles / IPIBenchIterations);
+}
+
+/* Unmap: map pages at a scratch address and time unmapping them, which includes the shootdown on every other CPU */
+constexpr uintptr_t ScratchBase = KernelHeapBase + KernelHeapSize;
+constexpr size_t UnmapBenchIterations = 1000;
+constexpr size_t MaxUnmapBenchPages = 512;
+
+static void BenchUnmap(size_t pages) {
+    /* Every page maps the same frame, only the page tables matter here */
+    static uintptr_t frames[MaxUnmapBenchPages];
+    void *frame = Mem::AllocatePage();
+    if (!frame) return;
+
+    for (size_t i = 0; i < pages; i++) frames[i] = (uintptr_t)frame;
+
+    uint64_t cycles = 0;
+    for (size_t i = 0; i < UnmapBenchIterations; i++) {
+        if (VMM::MapPages(nullptr, ScratchBase, frames, pages, VMM::MAP_WRITE) != VMM::MAP_OK) break;
+
+        uint64_t start = CPU::ReadTSC();
+        VMM::UnmapRange(nullptr, ScratchBase, pages * 0x1000);
+        cycles += CPU::ReadTSC() - start;
+    }
+
+    Mem::FreePage(frame);
+
+    Log(KERNEL_LOG_INFO, "[BENCH] Unmap %d page(s) with %d CPU(s) online: %d cycles, %d per page\n",
+        pages, CPU::GetCPUCount(), cycles / UnmapBenchIterations, cycles / UnmapBenchIterations / pages);
+}
+
+/* Memory functions: throughput at sizes from a cache line to well past L2, against the old byte loop and the vector copies */
+constexpr size_t MemBenchBytes = 0x4000000; // Moved per size and function, so every size does the same amount of work
+constexpr size_t MaxMemBenchSize = 0x100000;
+
+static void ByteCopy(void *destination, const void *source, size_t n) {
+    volatile unsigned char *d = (volatile unsigned char *)destination;
+    const unsigned char *s = (const unsigned char *)source;
+
+    for (size_t i = 0; i < n; i++) d[i] = s[i];
+}
+
+static void LogThroughput(const char *name, size_t size, uint64_t cycles) {
+    Log(KERNEL_LOG_INFO, "[BENCH] %s %d bytes: %d bytes per 1000 cycles\n", name, size, (MemBenchBytes * 1000) / (cycles ? cycles : 1));
+}
+
+static void BenchMemory() {
+    uint8_t *source = (uint8_t *)Mem::Allocate(MaxMemBenchSize + 64);
+    uint8_t *destination = (uint8_t *)Mem::Allocate(MaxMemBenchSize + 64);
+    if (!source || !destination) return;
+
+    memset(source, 0x5A, MaxMemBenchSize + 64);
+
+    for (size_t size = 64; size <= MaxMemBenchSize; size *= 16) {
+        size_t rounds = MemBenchBytes / size;
+        uint64_t start;
+
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) ByteCopy(destination, source, size);
+        LogThroughput("byte loop", size, CPU::ReadTSC() - start);
+
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) memcpy(destination, source, size);
+        LogThroughput("memcpy", size, CPU::ReadTSC() - start);
+
+        /* The vector copies on their own, including saving and restoring the extended state */
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) {
+            KernelFpuBegin();
+            CopySSE2(destination, source, size);
+            KernelFpuEnd();
+        }
+        LogThroughput("SSE2 copy", size, CPU::ReadTSC() - start);
+
+        if (GetSIMDLevel() == CPU::SIMD_AVX2) {
+            start = CPU::ReadTSC();
+            for (size_t i = 0; i < rounds; i++) {
+                KernelFpuBegin();
+                CopyAVX2(destination, source, size);
+                KernelFpuEnd();
+            }
+            LogThroughput("AVX2 copy", size, CPU::ReadTSC() - start);
+        }
+
+        /* Misaligned by a few bytes, the usual case for Vector and string copies */
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) memcpy(destination + 3, source + 1, size);
+        LogThroughput("memcpy unaligned", size, CPU::ReadTSC() - start);
+
+        /* Overlapping, destination above the source, so it has to go backwards */
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) memmove(source + 64, source, size);
+        LogThroughput("memmove backwards", size, CPU::ReadTSC() - start);
+
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) memset(destination, 0, size);
+        LogThroughput("memset", size, CPU::ReadTSC() - start);
+
+        start = CPU::ReadTSC();
+        for (size_t i = 0; i < rounds; i++) {
+            if (memcmp(destination, destination + 32, size - 32)) break;
+        }
+        LogThroughput("memcmp", size, CPU::ReadTSC() - start);
+    }
+
+    Mem::Free(source);
+    Mem::Free(destination);
+}
+
+/*
+    String functions: checked against straightforward byte loops on every length and
+    alignment up to a few words, with the strings ending right at the end of a page
+    that has nothing mapped after it, so a read past the terminator faults.
+*/
+static int ReferenceStrncmp(const char *a, const char *b, int n) {
+    for (int i = 0; i < n; i++) {
+        if (a[i] != b[i]) return (unsigned char)a[i] - (unsigned char)b[i];
+        if (!a[i]) return 0;
+    }
+
+    return 0;
+}
+
+static int Sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+static bool CheckStrings() {
+    /* The scratch range is otherwise unused, the page after this one stays unmapped as a guard */
+    void *page = Mem::AllocatePage();
+    uintptr_t frame = (uintptr_t)page;
+    if (!page || VMM::MapPages(nullptr, ScratchBase, &frame, 1, VMM::MAP_WRITE) != VMM::MAP_OK) {
+        Mem::FreePage(page);
+        Log(KERNEL_LOG_INFO, "[BENCH] String functions: no memory for the guarded page, skipped\n");
+        return true;
+    }
+
+    char *pageEnd = (char *)ScratchBase + 0x1000;
+    char other[64];
+    size_t failures = 0;
+
+    for (int length = 0; length < 40; length++) {
+        for (int offset = 0; offset < 8; offset++) {
+            char *str = pageEnd - length - 1 - offset;
+            for (int i = 0; i < length; i++) str[i] = 'a' + (i * 7 + offset) % 5;
+            str[length] = '\0';
+
+            if (strlen(str) != length) failures++;
+            if (strnlen(str, length / 2) != length / 2) failures++;
+            if (strnlen(str, length + 5) != length) failures++;
+
+            for (int c = 'a'; c <= 'f'; c++) {
+                char *first = nullptr;
+                char *last = nullptr;
+                for (int i = 0; i < length; i++) {
+                    if (str[i] != c) continue;
+                    if (!first) first = &str[i];
+                    last = &str[i];
+                }
+
+                if (strchr(str, c) != first || strrchr(str, c) != last) failures++;
+                if (memchr(str, c, length) != first) failures++;
+            }
+            if (strchr(str, 0) != str + length || strrchr(str, 0) != str + length) failures++;
+
+            /* Same string, then one that differs in its last character, then a shorter one */
+            char *copy = other + (offset * 3) % 8;
+            strcpy(copy, str);
+            for (int n = 0; n <= length + 2; n++) {
+                if (Sign(strncmp(str, copy, n)) != Sign(ReferenceStrncmp(str, copy, n))) failures++;
+            }
+
+            if (length) {
+                copy[length - 1]++;
+                if (Sign(strncmp(str, copy, length)) != Sign(ReferenceStrncmp(str, copy, length))) failures++;
+                if (Sign(strncmp(copy, str, length + 1)) != Sign(ReferenceStrncmp(copy, str, length + 1))) failures++;
+
+                copy[length / 2] = '\0';
+                if (Sign(strncmp(str, copy, length + 1)) != Sign(ReferenceStrncmp(str, copy, length + 1))) failures++;
+            }
+        }
+    }
+
+    VMM::UnmapRange(nullptr, ScratchBase, 0x1000);
+    Mem::FreePage(page);
+
+    Log(KERNEL_LOG_INFO, "[BENCH] String functions: %d mismatches against the reference\n", failures);
+    return failures == 0;
+}
+
+/* Path lookups: every file in the ramdisk looked up by name, against a byte-wise compare */
+constexpr size_t LookupBenchRounds = 1000;
+
+static void BenchRamdiskLookups() {
+    Obj::TarObject *ramdisk = Obj::GetFirstRamdisk();
+    if (!ramdisk) return;
+
+    Lib::Vector<Obj::TarObject::File> &files = ramdisk->GetAll();
+    if (!files.size()) return;
+
+    size_t found = 0;
+    uint64_t start = CPU::ReadTSC();
+    for (size_t round = 0; round < LookupBenchRounds; round++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            if (ramdisk->Get(files.at(i).Path).Path) found++;
+        }
+    }
+    uint64_t wordCycles = CPU::ReadTSC() - start;
+
+    start = CPU::ReadTSC();
+    for (size_t round = 0; round < LookupBenchRounds; round++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            for (size_t j = 0; j < files.size(); j++) {
+                if (!ReferenceStrncmp(files.at(j).Path, files.at(i).Path, 100)) {
+                    found++;
+                    break;
+                }
+            }
+        }
+    }
+    uint64_t byteCycles = CPU::ReadTSC() - start;
+
+    size_t lookups = LookupBenchRounds * files.size();
+    Log(KERNEL_LOG_INFO, "[BENCH] Ramdisk lookups over %d files: %d cycles each, %d with byte-wise compares (%d found)\n",
+        files.size(), wordCycles / lookups, byteCycles / lookups, found);
+}
+
+namespace Kernel::Debug {
+    void RunBenchmarks() {
+        Log(KERNEL_LOG_INFO, "[BENCH] Running kernel benchmarks on %d CPU(s)\n", CPU::GetCPUCount());
+
+        if (!CheckPageDoubleFree()) Panic("[BENCH] The PMM accepted a double free of a merged page.");
+
+        BenchHeapScaling(64);
+        BenchHeapScaling(2048);
+
+        BenchLock("Test-and-set", FlagLockLoop);
+        BenchLock("Ticket", TicketLockLoop);
+        BenchLock("Queued", QueuedLockLoop);
+        BenchReadLock();
+
+        BenchScheduler();
+        BenchWorkQueue();
+        BenchIPI();
+
+        BenchMemory();
+
+        /* The lookup benchmark times the word-at-a-time strncmp, its numbers mean nothing if that's wrong */
+        if (!CheckStrings()) Panic("[BENCH] The string functions don't match the reference.");
+        BenchRamdiskLookups();
+
+        BenchUnmap(1);
+        BenchUnmap(16);
+        BenchUnmap(32);
+        BenchUnmap(512);
+
+        Log(KERNEL_LOG_INFO, "[BENCH] Done\n");
+    }
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+    * lockstats.cpp
+    * Lock contention statistics, built with make LOCKSTATS=1
+    * Created 17/10/2026
+*/
+
+#ifdef KERNEL_LOCK_STATS
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hal/debug/lockstats.hpp>
+#include <hal/debug/serial.hpp>
+#include <hal/cpu.hpp>
+#include <libs/string.hpp>
+
+/* Every lock that has been taken at least once, pushed on its first acquisition */
+static Kernel::Debug::LockStats *volatile RegisteredLocks = nullptr;
+
+static void WriteNumber(Kernel::Debug::SerialPort *port, uint64_t value, size_t width) {
+    char buffer[21];
+    size_t length = 0;
+
+    do {
+        buffer[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    /* Right aligned in a column */
+    for (size_t i = length; i < width; i++) port->WriteCharacter(' ');
+    while (length) port->WriteCharacter(buffer[--length]);
+}
+
+namespace Kernel::Debug {
+    void LockStatsAquired(LockStats *stats, uint64_t start, bool contended) {
+        if (!stats->Name) return;
+
+        uint64_t now = CPU::ReadTSC();
+
+        if (!stats->Registered) {
+            stats->Registered = true;
+            stats->Next = __atomic_load_n(&RegisteredLocks, __ATOMIC_RELAXED);
+            while (!__atomic_compare_exchange_n(&RegisteredLocks, &stats->Next, stats, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        }
+
+        stats->Acquisitions++;
+        if (contended) {
+            stats->Contended++;
+            stats->SpinCycles += now - start;
+        }
+
+        stats->AquiredAt = now;
+    }
+
+    void LockStatsReleasing(LockStats *stats) {
+        if (!stats->Name) return;
+
+        uint64_t held = CPU::ReadTSC() - stats->AquiredAt;
+        if (held > stats->MaxHoldCycles) stats->MaxHoldCycles = held;
+    }
+
+    void DumpLockStats(SerialPort *port) {
+        port->WriteString("\r\n[LOCKSTATS]                 name  acquisitions     contended   spin cycles avg spin  max hold\r\n");
+
+        LockStats *first = __atomic_load_n(&RegisteredLocks, __ATOMIC_ACQUIRE);
+        for (LockStats *stats = first; stats; stats = stats->Next) {
+            /* Only print a name at its first occurrence, with every lock of that name added up */
+            bool seen = false;
+            for (LockStats *other = first; other != stats; other = other->Next) {
+                if (!strncmp(other->Name, stats->Name, 64)) seen = true;
+            }
+            if (seen) continue;
+
+            uint64_t acquisitions = 0, contended = 0, spinCycles = 0, maxHold = 0;
+            for (LockStats *other = stats; other; other = other->Next) {
+                if (strncmp(other->Name, stats->Name, 64)) continue;
+
+                acquisitions += other->Acquisitions;
+                contended += other->Contended;
+                spinCycles += other->SpinCycles;
+                if (other->MaxHoldCycles > maxHold) maxHold = other->MaxHoldCycles;
+            }
+
+            port->WriteString("[LOCKSTATS] ");
+            for (size_t i = strlen(stats->Name); i < 20; i++) port->WriteCharacter(' ');
+            port->WriteString(stats->Name);
+            WriteNumber(port, acquisitions, 14);
+            WriteNumber(port, contended, 14);
+            WriteNumber(port, spinCycles, 14);
+            WriteNumber(port, contended ? spinCycles / contended : 0, 9);
+            WriteNumber(port, maxHold, 10);
+            port->WriteString("\r\n");
+        }
+    }
+}
+
+#endif
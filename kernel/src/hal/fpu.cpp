@@ -0,0 +1,113 @@
+/*
+    * fpu.cpp
+    * Kernel use of the FPU and vector registers
+    * Created 17/10/2026
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hal/fpu.hpp>
+#include <hal/cpu.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <libs/cpuid.hpp>
+#include <libs/kernel.hpp>
+
+constexpr uint64_t CR0MP = 1 << 1;
+constexpr uint64_t CR0EM = 1 << 2;
+constexpr uint64_t CR0TS = 1 << 3;
+constexpr uint64_t CR4OSFXSR = 1 << 9;
+constexpr uint64_t CR4OSXMMEXCPT = 1 << 10;
+constexpr uint64_t CR4OSXSAVE = 1 << 18;
+
+constexpr uint64_t XCR0X87 = 1 << 0;
+constexpr uint64_t XCR0SSE = 1 << 1;
+constexpr uint64_t XCR0AVX = 1 << 2;
+
+/* Room for x87, SSE and AVX state in the standard XSAVE layout (832 bytes), AVX-512 isn't turned on */
+constexpr size_t SaveAreaSize = 1024;
+
+struct FPUState {
+    uint8_t SaveArea[SaveAreaSize];
+    uint64_t Flags;
+    uint32_t Depth;
+}__attribute__((aligned(64)));
+
+static PERCPU_CREATE(FPUState, States);
+
+static int Level = Kernel::CPU::SIMD_NONE;
+static bool UseXSAVE = false;
+static uint64_t XCR0 = 0;
+
+static inline void WriteXCR0(uint64_t value) {
+    asm volatile ("xsetbv" : : "c"(0), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+namespace Kernel::CPU {
+    void InitializeFPU() {
+        uint32_t eax, ebx, ecx, edx;
+        bool bsp = GetCPUIndex() == 0;
+
+        /* Native x87 error reporting, no emulation, no lazy switching trap */
+        WriteCR0((ReadCR0() | CR0MP) & ~(CR0EM | CR0TS));
+        WriteCR4(ReadCR4() | CR4OSFXSR | CR4OSXMMEXCPT);
+
+        if (bsp) {
+            Kernel::Cpuid(1, &eax, &ebx, &ecx, &edx);
+            UseXSAVE = ecx & (1 << 26);
+            bool avx = ecx & (1 << 28);
+
+            XCR0 = XCR0X87 | XCR0SSE;
+            if (UseXSAVE && avx) XCR0 |= XCR0AVX;
+
+            Level = SIMD_SSE2; // Always there in long mode
+        }
+
+        if (UseXSAVE) {
+            WriteCR4(ReadCR4() | CR4OSXSAVE);
+            WriteXCR0(XCR0);
+        }
+
+        asm volatile ("fninit");
+
+        if (!bsp) return;
+
+        if (UseXSAVE) {
+            /* Size of the XSAVE area for the features now enabled in XCR0 */
+            Kernel::Cpuid(0xD, &eax, &ebx, &ecx, &edx);
+            if (ebx > SaveAreaSize) Panic("[FPU] Extended state doesn't fit in the save area.");
+        }
+
+        Kernel::Cpuid(0, &eax, &ebx, &ecx, &edx);
+        if ((XCR0 & XCR0AVX) && eax >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            if (ebx & (1 << 5)) Level = SIMD_AVX2;
+        }
+    }
+}
+
+extern "C" int GetSIMDLevel() {
+    return Level;
+}
+
+extern "C" void KernelFpuBegin() {
+    uint64_t flags = Kernel::CPU::SaveAndDisableInterrupts();
+    FPUState *state = &States.Local();
+
+    if (state->Depth++) return;
+
+    state->Flags = flags;
+    if (UseXSAVE) asm volatile ("xsave %0" : "=m"(state->SaveArea) : "a"((uint32_t)XCR0), "d"((uint32_t)(XCR0 >> 32)) : "memory");
+    else asm volatile ("fxsave %0" : "=m"(state->SaveArea) : : "memory");
+}
+
+extern "C" void KernelFpuEnd() {
+    FPUState *state = &States.Local();
+
+    if (!state->Depth) Kernel::Panic("[FPU] KernelFpuEnd without KernelFpuBegin.");
+    if (--state->Depth) return;
+
+    if (UseXSAVE) asm volatile ("xrstor %0" : : "m"(state->SaveArea), "a"((uint32_t)XCR0), "d"((uint32_t)(XCR0 >> 32)) : "memory");
+    else asm volatile ("fxrstor %0" : : "m"(state->SaveArea) : "memory");
+
+    Kernel::CPU::RestoreInterrupts(state->Flags);
+}
@@ -0,0 +1,55 @@
+/*
+    * rwlock.cpp
+    * Reader-writer locks
+    * Created 17/10/2026
+*/
+
+#include <hal/rwlock.hpp>
+#include <sched/preempt.hpp>
+
+namespace Kernel {
+    void RWLock::AquireRead() {
+        /* A preempted reader would hold up every writer for a whole time slice */
+        Sched::PreemptDisable();
+
+        while (true) {
+            ReaderCount *readers = &Readers[CPU::GetCPUIndex()];
+
+            /* Count ourselves in, then check for a writer. Either it sees our count or we see it writing. */
+            __atomic_fetch_add(&readers->Count, 1, __ATOMIC_SEQ_CST);
+            if (!__atomic_load_n(&Writing, __ATOMIC_SEQ_CST)) return;
+
+            /* Let the writer go first */
+            __atomic_fetch_sub(&readers->Count, 1, __ATOMIC_RELEASE);
+            while (__atomic_load_n(&Writing, __ATOMIC_RELAXED)) {
+                CPU::Pause();
+            }
+        }
+    }
+
+    void RWLock::ReleaseRead() {
+        __atomic_fetch_sub(&Readers[CPU::GetCPUIndex()].Count, 1, __ATOMIC_RELEASE);
+        Sched::PreemptEnable();
+    }
+
+    void RWLock::AquireWrite() {
+        WriterLock.Aquire();
+        __atomic_store_n(&Writing, true, __ATOMIC_SEQ_CST);
+
+        /* Wait for the readers that got in before us */
+        while (true) {
+            int32_t readers = 0;
+            for (size_t i = 0; i < CPU::MaxCPUCount; i++) {
+                readers += __atomic_load_n(&Readers[i].Count, __ATOMIC_ACQUIRE);
+            }
+
+            if (!readers) break;
+            CPU::Pause();
+        }
+    }
+
+    void RWLock::ReleaseWrite() {
+        __atomic_store_n(&Writing, false, __ATOMIC_RELEASE);
+        WriterLock.Release();
+    }
+}
@@ -0,0 +1,177 @@
+/*
+    * spinlock.cpp
+    * Spinlock implementation
+    * Created 02/09/2023 DanielH
+    * Ticket and queued locks 17/10/2026
+*/
+
+#include <hal/spinlock.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <libs/kernel.hpp>
+#include <sched/preempt.hpp>
+
+extern "C" void SpinlockAquire(volatile bool* lock)
+{
+    while (__atomic_test_and_set((bool *)lock, __ATOMIC_ACQUIRE)) {
+        /* Wait for it to look free before trying again, so waiters share the line instead of bouncing it */
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED)) {
+            Kernel::CPU::Pause();
+        }
+    }
+}
+
+extern "C" void SpinlockRelease(volatile bool *lock)
+{
+    __atomic_clear((bool *)lock, __ATOMIC_RELEASE);
+}
+
+namespace Kernel {
+    void Spinlock::Aquire() {
+        Sched::PreemptDisable();
+#ifdef KERNEL_LOCK_STATS
+        uint64_t start = CPU::ReadTSC();
+        bool contended = false;
+#endif
+        uint32_t ticket = __atomic_fetch_add(&Next, 1, __ATOMIC_RELAXED);
+
+        while (true) {
+            uint32_t owner = __atomic_load_n(&Owner, __ATOMIC_ACQUIRE);
+            if (owner == ticket) break;
+
+#ifdef KERNEL_LOCK_STATS
+            contended = true;
+#endif
+            /* Back off in proportion to the number of waiters ahead, each will take the lock for a while */
+            for (uint32_t i = ticket - owner; i > 0; i--) {
+                CPU::Pause();
+            }
+        }
+
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStatsAquired(&Stats, start, contended);
+#endif
+    }
+
+    bool Spinlock::TryAquire() {
+        Sched::PreemptDisable();
+
+        /* Only take a ticket if it's the one being served, i.e. the lock is free */
+        uint32_t owner = __atomic_load_n(&Owner, __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&Next, &owner, owner + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            Sched::PreemptEnable();
+            return false;
+        }
+
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStatsAquired(&Stats, CPU::ReadTSC(), false);
+#endif
+        return true;
+    }
+
+    void Spinlock::Release() {
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStatsReleasing(&Stats);
+#endif
+        __atomic_store_n(&Owner, Owner + 1, __ATOMIC_RELEASE);
+        Sched::PreemptEnable();
+    }
+
+    /*
+        Every CPU owns QueueNodesPerCPU nodes, with a bit per node saying whether it's in
+        use. Claiming and returning is atomic, a node might be returned from another CPU
+        (or by the same one from an interrupt) than the one it was claimed on.
+    */
+    static QueueNode QueueNodes[CPU::MaxCPUCount][QueueNodesPerCPU];
+    static volatile uint8_t QueueNodesUsed[CPU::MaxCPUCount];
+
+    static QueueNode *ClaimQueueNode() {
+        size_t cpu = CPU::GetCPUIndex();
+        uint8_t used = __atomic_load_n(&QueueNodesUsed[cpu], __ATOMIC_RELAXED);
+
+        while (true) {
+            if (used == (1 << QueueNodesPerCPU) - 1) Panic("[LOCK] Too many queued spinlocks held on one CPU.");
+
+            unsigned int slot = __builtin_ctz(~used);
+            if (__atomic_compare_exchange_n(&QueueNodesUsed[cpu], &used, used | (1 << slot), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return &QueueNodes[cpu][slot];
+            }
+        }
+    }
+
+    static void ReturnQueueNode(QueueNode *node) {
+        size_t index = node - &QueueNodes[0][0];
+
+        __atomic_fetch_and(&QueueNodesUsed[index / QueueNodesPerCPU], (uint8_t)~(1 << (index % QueueNodesPerCPU)), __ATOMIC_RELEASE);
+    }
+
+    void QueuedSpinlock::Aquire() {
+        /* Also keeps us on the CPU whose node we claim */
+        Sched::PreemptDisable();
+#ifdef KERNEL_LOCK_STATS
+        uint64_t start = CPU::ReadTSC();
+#endif
+        QueueNode *node = ClaimQueueNode();
+        node->Next = nullptr;
+        node->Waiting = true;
+
+        QueueNode *previous = __atomic_exchange_n(&Tail, node, __ATOMIC_ACQ_REL);
+        if (previous) {
+            /* Queue up behind the previous waiter, it clears Waiting when it releases */
+            __atomic_store_n(&previous->Next, node, __ATOMIC_RELEASE);
+
+            while (__atomic_load_n(&node->Waiting, __ATOMIC_ACQUIRE)) {
+                CPU::Pause();
+            }
+        }
+
+        Holder = node;
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStatsAquired(&Stats, start, previous != nullptr);
+#endif
+    }
+
+    bool QueuedSpinlock::TryAquire() {
+        Sched::PreemptDisable();
+        QueueNode *node = ClaimQueueNode();
+        node->Next = nullptr;
+
+        QueueNode *expected = nullptr;
+        if (!__atomic_compare_exchange_n(&Tail, &expected, node, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            ReturnQueueNode(node);
+            Sched::PreemptEnable();
+            return false;
+        }
+
+        Holder = node;
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStatsAquired(&Stats, CPU::ReadTSC(), false);
+#endif
+        return true;
+    }
+
+    void QueuedSpinlock::Release() {
+#ifdef KERNEL_LOCK_STATS
+        Debug::LockStatsReleasing(&Stats);
+#endif
+        QueueNode *node = Holder;
+        QueueNode *next = __atomic_load_n(&node->Next, __ATOMIC_ACQUIRE);
+
+        if (!next) {
+            /* Nobody queued, the lock becomes free. Otherwise a waiter is between taking the tail and linking itself in. */
+            QueueNode *expected = node;
+            if (__atomic_compare_exchange_n(&Tail, &expected, nullptr, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                ReturnQueueNode(node);
+                Sched::PreemptEnable();
+                return;
+            }
+
+            while (!(next = __atomic_load_n(&node->Next, __ATOMIC_ACQUIRE))) {
+                CPU::Pause();
+            }
+        }
+
+        __atomic_store_n(&next->Waiting, false, __ATOMIC_RELEASE);
+        ReturnQueueNode(node);
+        Sched::PreemptEnable();
+    }
+}
@@ -0,0 +1,265 @@
+/*
+    * tlb.cpp
+    * TLB shootdown across CPUs, and PCIDs
+    * Created 17/10/2026
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hal/tlb.hpp>
+#include <hal/vmm.hpp>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <hal/cpu/smp/call.hpp>
+#include <hal/cpu/interrupt/apic.hpp>
+#include <libs/cpuid.hpp>
+#include <terminal/terminal.hpp>
+
+/*
+    Each CPU has a queue of pages other CPUs want it to invalidate. An initiator
+    appends its pages to every other online CPU's queue, sends an IPI only if
+    one isn't already on its way, and waits for each CPU to report that it has
+    serviced a batch at least as new as its own. Requests from several CPUs
+    pile up in the same queue and are handled by a single interrupt.
+*/
+constexpr size_t PageSize = 0x1000;
+
+/* Past this many pages, flushing everything is cheaper than invlpg for each one */
+constexpr size_t FlushAllThreshold = 32;
+
+struct ShootdownEntry {
+    PageTable *PageMap;
+    uintptr_t Virt;
+};
+
+struct ShootdownQueue {
+    volatile bool Lock;
+    bool FlushAll;
+    /* An IPI has been sent and the CPU hasn't picked the queue up yet */
+    bool IPIPending;
+    size_t Count;
+    ShootdownEntry Entries[FlushAllThreshold];
+    /* Bumped for every batch queued, Completed is the newest one the CPU has serviced */
+    size_t Requested;
+    size_t Completed;
+}__attribute__((aligned(64)));
+
+static PERCPU_CREATE(ShootdownQueue, Queues);
+
+/*
+    With PCIDs every CPU keeps the TLB entries of its last few page maps around,
+    tagged with the PCID they were loaded under, so switching back to one
+    doesn't start from a cold TLB. Kernel mappings are global and shared by
+    every PCID. PCID 0 is only used before PCIDs are turned on.
+*/
+constexpr size_t PCIDsPerCPU = 6;
+
+struct PCIDSlots {
+    PageTable *PageMaps[PCIDsPerCPU];
+    size_t Current;
+    size_t NextVictim;
+}__attribute__((aligned(64)));
+
+static PERCPU_CREATE(PCIDSlots, Slots);
+
+static bool UsePCID = false;
+static bool UseINVPCID = false;
+
+constexpr uint64_t CR3NoFlush = (uint64_t)1 << 63;
+constexpr uint64_t CR4PGE = 1 << 7;
+constexpr uint64_t CR4PCIDE = 1 << 17;
+
+/* Every TLB entry of every PCID, global ones included */
+static void FlushEverything() {
+    if (UseINVPCID) {
+        Kernel::CPU::InvalidatePCID(Kernel::CPU::INVPCID_ALL_INCLUDING_GLOBAL, 0, 0);
+        return;
+    }
+
+    /* Toggling CR4.PGE flushes everything, including global pages */
+    uint64_t cr4 = Kernel::CPU::ReadCR4();
+    Kernel::CPU::WriteCR4(cr4 & ~CR4PGE);
+    Kernel::CPU::WriteCR4(cr4);
+}
+
+static inline bool IsKernelAddress(uintptr_t virt) {
+    return virt >= KernelHalfBase;
+}
+
+/*
+    Invalidates one page on this CPU. Kernel pages are global, which invlpg drops
+    whatever PCID is loaded. A user page is dropped right away if its page map
+    is the loaded one, other PCIDs holding that page map lose it and get
+    flushed when they are next loaded.
+*/
+static void InvalidateLocal(PCIDSlots *slots, PageTable *pagemap, uintptr_t virt) {
+    if (IsKernelAddress(virt) || slots->PageMaps[slots->Current] == pagemap) Kernel::CPU::InvalidatePage(virt);
+    if (IsKernelAddress(virt)) return;
+
+    for (size_t i = 0; i < PCIDsPerCPU; i++) {
+        if (i != slots->Current && slots->PageMaps[i] == pagemap) slots->PageMaps[i] = nullptr;
+    }
+}
+
+namespace Kernel::VMM {
+    void InitializeTLB() {
+        uint32_t eax, ebx, ecx, edx;
+        bool bsp = CPU::GetCPUIndex() == 0;
+
+        if (bsp) {
+            Kernel::Cpuid(1, &eax, &ebx, &ecx, &edx);
+            UsePCID = ecx & (1 << 17);
+
+            Kernel::Cpuid(0, &eax, &ebx, &ecx, &edx);
+            if (UsePCID && eax >= 7) {
+                Kernel::Cpuid(7, &eax, &ebx, &ecx, &edx);
+                UseINVPCID = ebx & (1 << 10);
+            }
+        }
+
+        /* Turning PGE off and on also drops any global entries left over from the bootloader's page tables */
+        uint64_t cr4 = CPU::ReadCR4();
+        CPU::WriteCR4(cr4 & ~CR4PGE);
+        cr4 |= CR4PGE;
+        CPU::WriteCR4(cr4);
+
+        /* CR3 has PCID 0 at this point, which is the only one PCIDE may be turned on with */
+        if (UsePCID) CPU::WriteCR4(cr4 | CR4PCIDE);
+
+        SwitchPageMap(GetKernelPageMap());
+
+        if (bsp) {
+            Log(KERNEL_LOG_INFO, "[VMM] Global kernel pages, PCIDs %s, INVPCID %s\n",
+                UsePCID ? "enabled" : "not supported", UseINVPCID ? "enabled" : "not supported");
+        }
+    }
+
+    void SwitchPageMap(PageTable *pagemap) {
+        uint64_t cr3 = HHDMVirtToPhys((uintptr_t)pagemap);
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        PCIDSlots *slots = &Slots.Local();
+
+        if (!UsePCID) {
+            slots->PageMaps[0] = pagemap;
+            slots->Current = 0;
+            CPU::WriteCR3(cr3);
+            CPU::RestoreInterrupts(flags);
+            return;
+        }
+
+        /* Still tagged on this CPU, its TLB entries are valid */
+        for (size_t i = 0; i < PCIDsPerCPU; i++) {
+            if (slots->PageMaps[i] == pagemap) {
+                slots->Current = i;
+                CPU::WriteCR3(cr3 | (i + 1) | CR3NoFlush);
+                CPU::RestoreInterrupts(flags);
+                return;
+            }
+        }
+
+        /* Take over the oldest PCID, loading without the no flush bit drops what it had */
+        size_t slot = slots->NextVictim;
+        if (slot == slots->Current && slots->PageMaps[slot]) slot = (slot + 1) % PCIDsPerCPU;
+        slots->NextVictim = (slot + 1) % PCIDsPerCPU;
+
+        slots->PageMaps[slot] = pagemap;
+        slots->Current = slot;
+        CPU::WriteCR3(cr3 | (slot + 1));
+
+        CPU::RestoreInterrupts(flags);
+    }
+
+    void ServiceTLBShootdowns() {
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        ShootdownQueue *queue = &Queues.Local();
+
+        /* Nothing queued since last time */
+        if (__atomic_load_n(&queue->Requested, __ATOMIC_ACQUIRE) == queue->Completed) {
+            CPU::RestoreInterrupts(flags);
+            return;
+        }
+
+        ShootdownEntry entries[FlushAllThreshold];
+
+        SpinlockAquire(&queue->Lock);
+        size_t count = queue->Count;
+        bool flushAll = queue->FlushAll;
+        size_t batch = queue->Requested;
+        for (size_t i = 0; i < count; i++) entries[i] = queue->Entries[i];
+
+        queue->Count = 0;
+        queue->FlushAll = false;
+        queue->IPIPending = false;
+        SpinlockRelease(&queue->Lock);
+
+        PCIDSlots *slots = &Slots.Local();
+        if (flushAll) FlushEverything();
+        else for (size_t i = 0; i < count; i++) InvalidateLocal(slots, entries[i].PageMap, entries[i].Virt);
+
+        __atomic_store_n(&queue->Completed, batch, __ATOMIC_RELEASE);
+        CPU::RestoreInterrupts(flags);
+    }
+
+    void FlushTLB(PageTable *pagemap, uintptr_t virt, size_t length, bool freedTables) {
+        size_t pages = (length + PageSize - 1) / PageSize;
+
+        /*
+            invlpg only drops paging-structure caches for the loaded PCID, so freed page
+            tables could still be walked through another one: flush everything then.
+        */
+        bool flushAll = pages > FlushAllThreshold || (freedTables && UsePCID);
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        size_t self = CPU::GetCPUIndex();
+
+        if (flushAll) FlushEverything();
+        else for (size_t i = 0; i < pages; i++) InvalidateLocal(&Slots[self], pagemap, virt + i * PageSize);
+
+        size_t batches[CPU::MaxCPUCount];
+
+        /* The page table writes have to be visible before looking at who might have cached them */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        for (size_t cpu = 0; cpu < CPU::GetCPUCount(); cpu++) {
+            batches[cpu] = 0;
+            if (cpu == self || !CPU::IsCPUOnline(cpu)) continue;
+
+            ShootdownQueue *queue = &Queues[cpu];
+
+            SpinlockAquire(&queue->Lock);
+            if (flushAll || queue->FlushAll || queue->Count + pages > FlushAllThreshold) {
+                queue->FlushAll = true;
+                queue->Count = 0;
+            } else {
+                for (size_t i = 0; i < pages; i++) queue->Entries[queue->Count++] = ShootdownEntry {pagemap, virt + i * PageSize};
+            }
+
+            batches[cpu] = ++queue->Requested;
+            bool sendIPI = !queue->IPIPending;
+            queue->IPIPending = true;
+            SpinlockRelease(&queue->Lock);
+
+            if (sendIPI) CPU::SendIPI(CPU::GetCPUApicId(cpu), TLBShootdownVector);
+        }
+
+        /* Keep servicing our own queue while waiting, a CPU waiting on us would deadlock otherwise */
+        for (size_t cpu = 0; cpu < CPU::GetCPUCount(); cpu++) {
+            if (!batches[cpu]) continue;
+
+            while (__atomic_load_n(&Queues[cpu].Completed, __ATOMIC_ACQUIRE) < batches[cpu]) {
+                ServiceTLBShootdowns();
+                CPU::ServiceCallQueue();
+                CPU::Pause();
+            }
+        }
+
+        CPU::RestoreInterrupts(flags);
+    }
+
+    __attribute__((interrupt)) void TLBShootdownInterrupt(CPU::Interrupts::CInterruptRegisters *) {
+        ServiceTLBShootdowns();
+        CPU::LAPIC_EOI();
+    }
+}
@@ -12,6 +12,10 @@
 #include <mm/mem.hpp>
 #include <libs/kernel.hpp>
 #include <early/bootloader_data.hpp>
+#include <libs/cpuid.hpp>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/tlb.hpp>
 
 extern BootloaderData GlobalBootloaderData;
 
@@ -23,23 +27,139 @@ static bool IsAligned(uintptr_t addr, size_t boundary) {
     return false;
 }
 
+/* Kept separately from the bootloader response, which doesn't stay around forever */
+static uintptr_t HHDMOffset = 0;
+
 /* Converts an HHDM virtual address to a physical address */
 uintptr_t HHDMVirtToPhys(uintptr_t virt) {
-    return virt - GlobalBootloaderData.hhdm_response->offset;
+    return virt - HHDMOffset;
 }
 
 /* Converts an physical address to an HHDM virtual address */
 uintptr_t HHDMPhysToVirt(uintptr_t phys) {
-    return phys + GlobalBootloaderData.hhdm_response->offset;
+    return phys + HHDMOffset;
+}
+
+constexpr uint64_t PageSize4K = 0x1000;
+constexpr uint64_t PageSize2M = 0x200000;
+constexpr uint64_t PageSize1G = 0x40000000;
+
+static bool Use1GiBPages = false;
+
+static Kernel::Spinlock VMM_Lock("VMM");
+
+/* Whether the CPU can map 1 GiB pages (CPUID.80000001h:EDX.Page1GB[bit 26]) */
+static bool Supports1GiBPages() {
+    uint32_t eax, ebx, ecx, edx;
+
+    Kernel::Cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000001) return false;
+
+    Kernel::Cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    return edx & (1 << 26);
+}
+
+/* Levels count from the PML4 (4) down to the page table (1) */
+static inline uint64_t LevelPageSize(int level) {
+    return (uint64_t)1 << (12 + 9 * (level - 1));
+}
+
+static inline size_t LevelIndex(uintptr_t virt, int level) {
+    return (virt >> (12 + 9 * (level - 1))) & 0x1FF;
+}
+
+static inline PageTable *TableAt(PageTableEntry *entry) {
+    return (PageTable *)HHDMPhysToVirt(entry->PhysicalAddr << 12);
+}
+
+/*
+    The PAT bit of a leaf is bit 7 in a page table entry, where large pages have
+    their PageSize bit, and bit 12 in a large page, the bottom of PhysicalAddr.
+*/
+static inline bool LeafPAT(PageTableEntry *entry, int level) {
+    return level == 1 ? entry->PageSize : entry->PhysicalAddr & 1;
+}
+
+static inline uintptr_t LeafAddress(PageTableEntry *entry, int level) {
+    return (entry->PhysicalAddr & ~(uintptr_t)(level == 1 ? 0 : 1)) << 12;
+}
+
+static inline void SetLeafPAT(PageTableEntry *entry, int level, bool pat) {
+    if (level == 1) entry->PageSize = pat;
+    else entry->PhysicalAddr = (entry->PhysicalAddr & ~(uintptr_t)1) | pat;
+}
+
+static void ApplyFlags(PageTableEntry *entry, int level, uint32_t flags) {
+    uint32_t patIndex = (flags & Kernel::VMM::MAP_CACHE_MASK) >> Kernel::VMM::MapCacheShift;
+
+    entry->RW = (flags & Kernel::VMM::MAP_WRITE) != 0;
+    entry->User = (flags & Kernel::VMM::MAP_USER) != 0;
+    entry->WriteThrough = (patIndex & 1) != 0;
+    entry->CacheDisable = (patIndex & 2) != 0;
+    SetLeafPAT(entry, level, (patIndex & 4) != 0);
+}
+
+static bool HasFlags(PageTableEntry *entry, int level, uint32_t flags) {
+    PageTableEntry expected = *entry;
+    ApplyFlags(&expected, level, flags);
+
+    return expected.RW == entry->RW && expected.User == entry->User &&
+        expected.WriteThrough == entry->WriteThrough && expected.CacheDisable == entry->CacheDisable &&
+        LeafPAT(&expected, level) == LeafPAT(entry, level);
+}
+
+/* Kernel half translations are the same in every address space, so they can outlive CR3 switches */
+static inline bool IsGlobal(uintptr_t virt, uint32_t flags) {
+    return virt >= KernelHalfBase && !(flags & Kernel::VMM::MAP_USER);
+}
+
+/*
+    Replaces a large page with a table of the next smaller page size covering the
+    same memory with the same attributes, so part of it can be remapped. The
+    translations don't change, so there is nothing to flush.
+*/
+static bool SplitLargePage(PageTableEntry *entry, int level) {
+    uint64_t largePageSize = LevelPageSize(level);
+    void *table_allocation = Kernel::Mem::AllocatePage(Kernel::Mem::PAGE_ALLOC_NO_ZERO);
+    if (!table_allocation) return false;
+    Kernel::Mem::SetPageOwner(table_allocation, Kernel::Mem::PAGE_OWNER_PAGETABLE);
+
+    PageTable *table = (PageTable *)HHDMPhysToVirt((uintptr_t)table_allocation);
+    uint64_t childSize = largePageSize / 512;
+    uintptr_t base = LeafAddress(entry, level);
+    bool pat = LeafPAT(entry, level);
+
+    for (size_t i = 0; i < 512; i++) {
+        table->entries[i] = *entry;
+        table->entries[i].PhysicalAddr = (base + i * childSize) >> 12;
+        table->entries[i].PageSize = level - 1 != 1;
+        SetLeafPAT(&table->entries[i], level - 1, pat);
+    }
+
+    /* The cache bits of a directory entry apply to the table it points to, which is ordinary memory */
+    entry->PhysicalAddr = (uintptr_t)table_allocation >> 12;
+    entry->PageSize = false;
+    entry->Global = false;
+    entry->WriteThrough = false;
+    entry->CacheDisable = false;
+    entry->RW = true;
+
+    return true;
 }
 
-static PageTable *GetNextLevel(PageTable *current_level, size_t entry) {
+/* level is that of current_level, large pages in it are split */
+static PageTable *GetNextLevel(PageTable *current_level, size_t entry, int level) {
     if (!current_level) return nullptr;
 
+    if (current_level->entries[entry].Present && current_level->entries[entry].PageSize && level != 4) {
+        if (!SplitLargePage(&current_level->entries[entry], level)) return nullptr;
+    }
+
     if (!current_level->entries[entry].Present) {
         void *new_entry = Kernel::Mem::AllocatePage();
         if (!new_entry) return nullptr;
         if (!IsAligned((uintptr_t)new_entry, 0x1000)) return nullptr;
+        Kernel::Mem::SetPageOwner(new_entry, Kernel::Mem::PAGE_OWNER_PAGETABLE);
 
         current_level->entries[entry].PhysicalAddr = ((uintptr_t)new_entry >> 12);
         current_level->entries[entry].Present = true;
@@ -49,83 +169,370 @@ static PageTable *GetNextLevel(PageTable *current_level, size_t entry) {
     } else return (PageTable *)(uintptr_t)HHDMPhysToVirt(current_level->entries[entry].PhysicalAddr << 12);
 }
 
-namespace Kernel::VMM {
-    /* Large page is 2MiB */
-    bool MemoryMap(PageTable *target_pagemap, uintptr_t virt, uintptr_t phys, bool largePage) {
-        if (!target_pagemap) {
-            if (!kernelPML4) {
-                return false;
+static bool TableEmpty(PageTable *table) {
+    for (size_t i = 0; i < 512; i++) {
+        if (table->entries[i].Present) return false;
+    }
+
+    return true;
+}
+
+/* Where a walk is up to. Frames, if set, supplies the physical address of every 4 KiB page instead of Phys. */
+struct MapCursor {
+    uintptr_t Virt;
+    uintptr_t Phys;
+    const uintptr_t *Frames;
+    size_t PagesMapped[3]; // 4 KiB, 2 MiB, 1 GiB
+    bool NeedsFlush;
+};
+
+/* Maps [cursor->Virt, end) below one table, only descending into each lower table once */
+static Kernel::VMM::MapError MapLevel(PageTable *table, int level, MapCursor *cursor, uintptr_t end, uint32_t flags) {
+    using namespace Kernel::VMM;
+    uint64_t size = LevelPageSize(level);
+
+    for (size_t i = LevelIndex(cursor->Virt, level); i < 512 && cursor->Virt < end; i++) {
+        PageTableEntry *entry = &table->entries[i];
+
+        bool largeAllowed = level == 2 || (level == 3 && Use1GiBPages);
+        bool leaf = level == 1 || (largeAllowed && !cursor->Frames && !(flags & MAP_NO_LARGE) &&
+            IsAligned(cursor->Virt, size) && IsAligned(cursor->Phys, size) && end - cursor->Virt >= size &&
+            (!entry->Present || entry->PageSize));
+
+        if (leaf) {
+            uintptr_t phys = cursor->Frames ? *cursor->Frames++ : cursor->Phys;
+            if (entry->Present) cursor->NeedsFlush = true;
+
+            *entry = PageTableEntry {};
+            entry->PhysicalAddr = phys >> 12;
+            entry->Present = true;
+            entry->PageSize = level != 1;
+            entry->Global = IsGlobal(cursor->Virt, flags);
+            ApplyFlags(entry, level, flags);
+
+            cursor->PagesMapped[level - 1]++;
+            cursor->Virt += size;
+            cursor->Phys += size;
+            continue;
+        }
+
+        /* Already covered by a large page mapping the same memory the same way, leave it be */
+        if (level != 4 && entry->Present && entry->PageSize && !cursor->Frames) {
+            uintptr_t pageVirt = ALIGN_DOWN(cursor->Virt, size);
+            uintptr_t coveredEnd = end < pageVirt + size ? end : pageVirt + size;
+
+            if (LeafAddress(entry, level) + (cursor->Virt - pageVirt) == cursor->Phys && HasFlags(entry, level, flags)) {
+                cursor->Phys += coveredEnd - cursor->Virt;
+                cursor->Virt = coveredEnd;
+                continue;
+            }
+        }
+
+        PageTable *next = GetNextLevel(table, i, level);
+        if (!next) return MAP_ERROR_NO_MEMORY;
+
+        /* Directory entries are permissive, the leaves decide */
+        if (flags & MAP_USER) entry->User = true;
+
+        MapError error = MapLevel(next, level - 1, cursor, end, flags);
+        if (error != MAP_OK) return error;
+    }
+
+    return MAP_OK;
+}
+
+/* Where an unmap is up to. Frames and FreedTables are filled in as it goes. */
+struct UnmapCursor {
+    uintptr_t Virt;
+    uintptr_t *Frames;
+    /* Emptied page tables, chained through their first entry and only freed once no TLB can walk them */
+    PageTable *FreedTables;
+};
+
+/* Unmaps [cursor->Virt, end) below one table, unlinking page tables (below the PML3s) that become empty */
+static Kernel::VMM::MapError UnmapLevel(PageTable *table, int level, UnmapCursor *cursor, uintptr_t end) {
+    using namespace Kernel::VMM;
+    uint64_t size = LevelPageSize(level);
+
+    for (size_t i = LevelIndex(cursor->Virt, level); i < 512 && cursor->Virt < end; i++) {
+        PageTableEntry *entry = &table->entries[i];
+        uintptr_t pageVirt = ALIGN_DOWN(cursor->Virt, size);
+        uintptr_t coveredEnd = end < pageVirt + size ? end : pageVirt + size;
+
+        if (!entry->Present) {
+            if (cursor->Frames) {
+                for (uintptr_t page = cursor->Virt; page < coveredEnd; page += PageSize4K) *cursor->Frames++ = 0;
+            }
+
+            cursor->Virt = coveredEnd;
+            continue;
+        }
+
+        if (level == 1 || entry->PageSize) {
+            if (cursor->Virt == pageVirt && coveredEnd == pageVirt + size) {
+                if (cursor->Frames) {
+                    for (uintptr_t offset = 0; offset < size; offset += PageSize4K) *cursor->Frames++ = LeafAddress(entry, level) + offset;
+                }
+
+                *entry = PageTableEntry {};
+                cursor->Virt = coveredEnd;
+                continue;
+            }
+
+            /* Only part of a large page goes away */
+            if (!SplitLargePage(entry, level)) return MAP_ERROR_NO_MEMORY;
+        }
+
+        PageTable *next = TableAt(entry);
+        MapError error = UnmapLevel(next, level - 1, cursor, end);
+        if (error != MAP_OK) return error;
+
+        /* PML3s stay, other address spaces may share them */
+        if (level <= 3 && TableEmpty(next)) {
+            *entry = PageTableEntry {};
+            *(PageTable **)next = cursor->FreedTables;
+            cursor->FreedTables = next;
+        }
+    }
+
+    return MAP_OK;
+}
+
+/* Changes the flags on [*virt, end) below one table, splitting large pages that are only partly covered */
+static Kernel::VMM::MapError ProtectLevel(PageTable *table, int level, uintptr_t *virt, uintptr_t end, uint32_t flags) {
+    using namespace Kernel::VMM;
+    uint64_t size = LevelPageSize(level);
+
+    for (size_t i = LevelIndex(*virt, level); i < 512 && *virt < end; i++) {
+        PageTableEntry *entry = &table->entries[i];
+        uintptr_t pageVirt = ALIGN_DOWN(*virt, size);
+        uintptr_t coveredEnd = end < pageVirt + size ? end : pageVirt + size;
+
+        if (!entry->Present) return MAP_ERROR_NOT_MAPPED;
+
+        if (level == 1 || entry->PageSize) {
+            if ((*virt == pageVirt && coveredEnd == pageVirt + size) || HasFlags(entry, level, flags)) {
+                ApplyFlags(entry, level, flags);
+                entry->Global = IsGlobal(pageVirt, flags);
+                *virt = coveredEnd;
+                continue;
             }
 
-            target_pagemap = kernelPML4;
+            if (!SplitLargePage(entry, level)) return MAP_ERROR_NO_MEMORY;
         }
 
-        size_t pml4_entry = (virt & ((uint64_t)0x1FF << 39)) >> 39;
-        size_t pml3_entry = (virt & ((uint64_t)0x1FF << 30)) >> 30;
-        size_t pml2_entry = (virt & ((uint64_t)0x1FF << 21)) >> 21;
-        size_t pml1_entry = (virt & ((uint64_t)0x1FF << 12)) >> 12;
-        size_t lowest_entry = pml1_entry;
-
-        PageTable *pml3 = GetNextLevel(target_pagemap, pml4_entry);
-        PageTable *pml2 = GetNextLevel(pml3, pml3_entry);
-        PageTable *lowest = nullptr;
-
-        if (!largePage) {
-            lowest = GetNextLevel(pml2, pml2_entry);
-        } else { 
-            lowest = pml2;
-            lowest_entry = pml2_entry;
-            lowest->entries[lowest_entry].PageSize = true;
+        if (flags & MAP_USER) entry->User = true;
+
+        MapError error = ProtectLevel(TableAt(entry), level - 1, virt, end, flags);
+        if (error != MAP_OK) return error;
+    }
+
+    return MAP_OK;
+}
+
+namespace Kernel::VMM {
+    void InitializeHHDM(uintptr_t offset) {
+        HHDMOffset = offset;
+    }
+
+    static bool CheckRange(PageTable **pagemap, uintptr_t virt, uintptr_t phys, size_t length, MapError *error) {
+        if (!*pagemap) *pagemap = kernelPML4;
+
+        if (!*pagemap) *error = MAP_ERROR_NO_PAGEMAP;
+        else if (!IsAligned(virt, PageSize4K) || !IsAligned(phys, PageSize4K) || !IsAligned(length, PageSize4K)) *error = MAP_ERROR_UNALIGNED;
+        else return true;
+
+        return false;
+    }
+
+    MapError MapRange(PageTable *pagemap, uintptr_t virt, uintptr_t phys, size_t length, uint32_t flags) {
+        MapError error = MAP_OK;
+        if (!CheckRange(&pagemap, virt, phys, length, &error)) return error;
+
+        MapCursor cursor = {};
+        cursor.Virt = virt;
+        cursor.Phys = phys;
+
+        uint64_t irq = VMM_Lock.AquireIrqSave();
+        error = MapLevel(pagemap, 4, &cursor, virt + length, flags);
+        VMM_Lock.ReleaseIrqRestore(irq);
+
+        if (cursor.NeedsFlush) FlushTLB(pagemap, virt, length);
+
+        return error;
+    }
+
+    MapError MapPages(PageTable *pagemap, uintptr_t virt, const uintptr_t *frames, size_t count, uint32_t flags) {
+        MapError error = MAP_OK;
+        if (!CheckRange(&pagemap, virt, 0, count * PageSize4K, &error)) return error;
+
+        MapCursor cursor = {};
+        cursor.Virt = virt;
+        cursor.Frames = frames;
+
+        uint64_t irq = VMM_Lock.AquireIrqSave();
+        error = MapLevel(pagemap, 4, &cursor, virt + count * PageSize4K, flags);
+        VMM_Lock.ReleaseIrqRestore(irq);
+
+        if (cursor.NeedsFlush) FlushTLB(pagemap, virt, count * PageSize4K);
+
+        return error;
+    }
+
+    MapError UnmapRange(PageTable *pagemap, uintptr_t virt, size_t length, uintptr_t *frames) {
+        MapError error = MAP_OK;
+        if (!CheckRange(&pagemap, virt, 0, length, &error)) return error;
+
+        UnmapCursor cursor = {};
+        cursor.Virt = virt;
+        cursor.Frames = frames;
+
+        uint64_t irq = VMM_Lock.AquireIrqSave();
+        error = UnmapLevel(pagemap, 4, &cursor, virt + length);
+        VMM_Lock.ReleaseIrqRestore(irq);
+
+        FlushTLB(pagemap, virt, length, cursor.FreedTables != nullptr);
+
+        while (cursor.FreedTables) {
+            PageTable *next = *(PageTable **)cursor.FreedTables;
+            Mem::FreePage((void *)HHDMVirtToPhys((uintptr_t)cursor.FreedTables));
+            cursor.FreedTables = next;
         }
 
-        if (!lowest) return false;
+        return error;
+    }
+
+    MapError ProtectRange(PageTable *pagemap, uintptr_t virt, size_t length, uint32_t flags) {
+        MapError error = MAP_OK;
+        if (!CheckRange(&pagemap, virt, 0, length, &error)) return error;
 
-        lowest->entries[lowest_entry].PhysicalAddr = ((uintptr_t)phys >> 12);
-        lowest->entries[lowest_entry].Present = true;
-        lowest->entries[lowest_entry].RW = true;
+        uintptr_t start = virt;
 
-        return true;
+        uint64_t irq = VMM_Lock.AquireIrqSave();
+        error = ProtectLevel(pagemap, 4, &virt, start + length, flags);
+        VMM_Lock.ReleaseIrqRestore(irq);
+
+        FlushTLB(pagemap, start, length);
+
+        return error;
     }
-    
+
+    bool GetPhysicalAddress(PageTable *pagemap, uintptr_t virt, uintptr_t *phys) {
+        if (!pagemap) pagemap = kernelPML4;
+        if (!pagemap) return false;
+
+        PageTable *table = pagemap;
+        for (int level = 4; level >= 1; level--) {
+            PageTableEntry *entry = &table->entries[LevelIndex(virt, level)];
+            if (!entry->Present) return false;
+
+            if (level == 1 || entry->PageSize) {
+                *phys = LeafAddress(entry, level) + (virt & (LevelPageSize(level) - 1));
+                return true;
+            }
+
+            table = TableAt(entry);
+        }
+
+        return false;
+    }
+
+    const char *MapErrorString(MapError error) {
+        switch (error) {
+            case MAP_OK: return "Success";
+            case MAP_ERROR_NO_PAGEMAP: return "No page map";
+            case MAP_ERROR_UNALIGNED: return "Address or length not page aligned";
+            case MAP_ERROR_NO_MEMORY: return "Out of memory for page tables";
+            case MAP_ERROR_NOT_MAPPED: return "Range is not mapped";
+            default: return "Unknown error";
+        }
+    }
+
     void InitPaging(
         limine_memmap_response memmap,
         limine_kernel_address_response kaddr
     ) {
+        uint64_t startCycles = CPU::ReadTSC();
+        size_t tablesBefore = Mem::GetOwnedMemory(Mem::PAGE_OWNER_PAGETABLE);
+
         void *pml4_allocation = Mem::AllocatePage();
         if (!pml4_allocation) {
             Panic("Unable to allocate memory for page map.");        
         }
+        Mem::SetPageOwner(pml4_allocation, Mem::PAGE_OWNER_PAGETABLE);
 
         PageTable *pml4 = (PageTable *)HHDMPhysToVirt((uintptr_t)pml4_allocation);
 
+        Use1GiBPages = Supports1GiBPages();
+
+        /* One cursor per range, but the page counts are summed up for the report */
+        MapCursor cursor = {};
+        size_t tablesFor4K = 0;
+
+        auto mapRange = [&](uintptr_t virt, uintptr_t phys, size_t length, uint32_t flags) {
+            cursor.Virt = virt;
+            cursor.Phys = phys;
+
+            /* With only 4 KiB pages every 2 MiB needs its own page table */
+            tablesFor4K += ALIGN_UP(length, PageSize2M) / PageSize2M;
+
+            if (MapLevel(pml4, 4, &cursor, virt + length, flags) != MAP_OK) Panic("Unable to allocate memory for the kernel page tables.");
+        };
+
+        /*
+            The HHDM covers every memory map entry, kernel and modules included. Entries
+            that touch are merged so the large pages can span them, except for the
+            framebuffer which is kept to itself.
+        */
+        uintptr_t runBase = 0;
+        uintptr_t runEnd = 0;
         for (size_t i = 0; i < memmap.entry_count; i++) {
-            switch (memmap.entries[i]->type) {
-                case LIMINE_MEMMAP_KERNEL_AND_MODULES: {
-                    for (uintptr_t j = 0; j < memmap.entries[i]->length; j += 4096) {
-                        uintptr_t phys = memmap.entries[i]->base + j;
-                        uintptr_t virt = phys + kaddr.virtual_base - kaddr.physical_base;
-
-                        MemoryMap(pml4, virt, phys, false);
-                    }
-                    break;
-                }
+            uintptr_t base = ALIGN_DOWN(memmap.entries[i]->base, 0x1000);
+            uintptr_t end = ALIGN_UP(memmap.entries[i]->base + memmap.entries[i]->length, 0x1000);
+            bool isolated = memmap.entries[i]->type == LIMINE_MEMMAP_FRAMEBUFFER;
 
-                default: {
-                    for (uintptr_t j = 0; j < memmap.entries[i]->length; j += 4096) {
-                        uintptr_t phys = memmap.entries[i]->base + j;
-                        uintptr_t virt = phys + GlobalBootloaderData.hhdm_response->offset;
+            if (!isolated && runEnd && base <= runEnd) {
+                if (end > runEnd) runEnd = end;
+                continue;
+            }
 
-                        MemoryMap(pml4, virt, phys, false);
-                    }
+            if (runEnd) mapRange(HHDMPhysToVirt(runBase), runBase, runEnd - runBase, MAP_WRITE);
+            runBase = base;
+            runEnd = end;
 
-                    break;
-                }
+            if (isolated) {
+                /* Writes to the framebuffer are combined into bursts instead of going out one store at a time */
+                mapRange(HHDMPhysToVirt(runBase), runBase, runEnd - runBase, MAP_WRITE | MAP_CACHE_WC);
+                runEnd = 0;
             }
         }
 
+        if (runEnd) mapRange(HHDMPhysToVirt(runBase), runBase, runEnd - runBase, MAP_WRITE);
+
+        /* The kernel image at its link address */
+        for (size_t i = 0; i < memmap.entry_count; i++) {
+            if (memmap.entries[i]->type != LIMINE_MEMMAP_KERNEL_AND_MODULES) continue;
+
+            uintptr_t phys = ALIGN_DOWN(memmap.entries[i]->base, 0x1000);
+            uintptr_t virt = phys + kaddr.virtual_base - kaddr.physical_base;
+            size_t length = ALIGN_UP(memmap.entries[i]->base + memmap.entries[i]->length, 0x1000) - phys;
+
+            mapRange(virt, phys, length, MAP_WRITE);
+        }
+
         kernelPML4 = pml4;
+
+        size_t tableMemory = Mem::GetOwnedMemory(Mem::PAGE_OWNER_PAGETABLE) - tablesBefore;
+        Log(KERNEL_LOG_INFO, "[VMM] Kernel mapped with %d x 1 GiB, %d x 2 MiB and %d x 4 KiB pages in %d cycles\n",
+            cursor.PagesMapped[2], cursor.PagesMapped[1], cursor.PagesMapped[0], CPU::ReadTSC() - startCycles);
+        Log(KERNEL_LOG_INFO, "[VMM] Page tables: %d KiB (4 KiB pages only would need at least %d KiB)\n",
+            tableMemory / 1024, tablesFor4K * 4);
    }
 
+    PageTable *GetKernelPageMap() {
+        return kernelPML4;
+    }
+
     void LoadKernelCR3() {
         LoadCR3((void *)HHDMVirtToPhys((uintptr_t)kernelPML4));
     }
@@ -2,49 +2,201 @@
     * string.c
     * String handling code
     * Created 09/09/2023
+    * Word-at-a-time versions 17/10/2026
 */
 #include <stddef.h>
+#include <stdint.h>
+
+/*
+    These look at 8 bytes at a time. A word has a zero byte exactly when
+    HasZero is non-zero, and the lowest set 0x80 bit is at the first zero
+    byte (x86 is little endian), so the tail is found with one bit scan.
+
+    Reads are done on aligned words, which never cross into the next page,
+    so reading a few bytes past the end of a string can't fault. Bytes in
+    the first word that come before the start of the string are masked off.
+    An unaligned read is only done when the page offset shows it stays in
+    the page.
+*/
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+#define PAGE_SIZE 0x1000
+
+typedef uint64_t __attribute__((may_alias)) word_t;
+typedef uint64_t __attribute__((may_alias, aligned(1))) unaligned_word_t;
+
+static inline uint64_t HasZero(uint64_t word) {
+    return (word - ONES) & ~word & HIGHS;
+}
+
+/* Index of the first zero byte, given HasZero(word) != 0 */
+static inline size_t FirstZero(uint64_t zeroes) {
+    return __builtin_ctzll(zeroes) / 8;
+}
+
+/* The aligned word holding str, with the bytes before str made non-zero */
+static inline uint64_t FirstWord(const char *str, const word_t **aligned) {
+    size_t offset = (uintptr_t)str & 7;
+    *aligned = (const word_t *)((uintptr_t)str - offset);
+
+    uint64_t word = **aligned;
+    if (offset) word |= ((uint64_t)1 << (offset * 8)) - 1;
+
+    return word;
+}
+
+static inline int CrossesPage(const void *pointer) {
+    return ((uintptr_t)pointer & (PAGE_SIZE - 1)) > PAGE_SIZE - 8;
+}
 
 int strncmp(const char *str1, const char *str2, int n) {
-    int i = 0;
+    if (n <= 0) return 0;
 
-    while (i != n && *str1 && (*str1 == *str2)) {
-        i++;
+    const unsigned char *s1 = (const unsigned char *)str1;
+    const unsigned char *s2 = (const unsigned char *)str2;
+    size_t remaining = n;
 
-        str1++;
-        str2++;
-    }
+    while (remaining) {
+        /* Whole words while neither string ends in them and they match */
+        if (remaining >= 8 && !CrossesPage(s1) && !CrossesPage(s2)) {
+            uint64_t w1 = *(const unaligned_word_t *)s1;
+            uint64_t w2 = *(const unaligned_word_t *)s2;
 
-    if (i == n) return 0;
+            if (w1 == w2 && !HasZero(w1)) {
+                s1 += 8;
+                s2 += 8;
+                remaining -= 8;
+                continue;
+            }
+        }
 
-    return *str1 - *str2;
+        /* The difference or the end is somewhere in the next 8 bytes (or right by a page boundary) */
+        size_t chunk = remaining < 8 ? remaining : 8;
+        for (size_t i = 0; i < chunk; i++) {
+            if (s1[i] != s2[i]) return s1[i] - s2[i];
+            if (!s1[i]) return 0;
+        }
+
+        s1 += chunk;
+        s2 += chunk;
+        remaining -= chunk;
+    }
+
+    return 0;
 }
 
 int strlen(const char *str) {
-    int i = 0;
+    const word_t *word;
+    uint64_t value = FirstWord(str, &word);
 
-    while (*str != '\0') {
-        i++;
-        str++;
-    }
+    while (!HasZero(value)) value = *++word;
 
-    return i;
+    return (const char *)word + FirstZero(HasZero(value)) - str;
 }
 
 int strnlen(const char *str, int n) {
-    int i = 0;
+    if (n <= 0) return 0;
 
-    while (i < n && *str != '\0') {
-        i++;
-        str++;
+    const word_t *word;
+    uint64_t value = FirstWord(str, &word);
+
+    while (!HasZero(value)) {
+        /* Past the limit without finding the end, the whole word is beyond str + n */
+        if ((const char *)(word + 1) - str >= n) return n;
+        value = *++word;
     }
 
-    return i;
+    int length = (const char *)word + FirstZero(HasZero(value)) - str;
+    return length < n ? length : n;
 }
 
 const char *strcpy(char *dest, const char *src) {
-    const char *tmp = dest;
-    while ((*dest++ = *src++) != '\0');
+    char *d = dest;
+
+    /* Bytes up to src's next word boundary */
+    while ((uintptr_t)src & 7) {
+        if (!(*d++ = *src++)) return dest;
+    }
+
+    /* Whole words until one holds the terminator, dest needn't be aligned */
+    const word_t *word = (const word_t *)src;
+    while (!HasZero(*word)) {
+        *(unaligned_word_t *)d = *word++;
+        d += 8;
+    }
+
+    src = (const char *)word;
+    while ((*d++ = *src++));
+
+    return dest;
+}
+
+void *memchr(const void *buffer, int c, size_t n) {
+    const unsigned char *bytes = (const unsigned char *)buffer;
+    unsigned char target = (unsigned char)c;
+    uint64_t pattern = ONES * target;
+
+    while (n && ((uintptr_t)bytes & 7)) {
+        if (*bytes == target) return (void *)bytes;
+        bytes++;
+        n--;
+    }
+
+    /* XOR turns matching bytes into zero bytes */
+    while (n >= 8) {
+        uint64_t zeroes = HasZero(*(const word_t *)bytes ^ pattern);
+        if (zeroes) return (void *)(bytes + FirstZero(zeroes));
+
+        bytes += 8;
+        n -= 8;
+    }
+
+    while (n--) {
+        if (*bytes == target) return (void *)bytes;
+        bytes++;
+    }
+
+    return NULL;
+}
+
+char *strchr(const char *str, int c) {
+    char target = (char)c;
+    uint64_t pattern = ONES * (unsigned char)target;
+
+    while ((uintptr_t)str & 7) {
+        if (*str == target) return (char *)str;
+        if (!*str) return NULL;
+        str++;
+    }
+
+    for (const word_t *word = (const word_t *)str; ; word++) {
+        uint64_t zeroes = HasZero(*word);
+        uint64_t matches = HasZero(*word ^ pattern);
+        if (!zeroes && !matches) continue;
+
+        /* Whichever comes first wins, a match on the terminator itself is strchr(str, 0) */
+        size_t end = zeroes ? FirstZero(zeroes) : 8;
+        size_t match = matches ? FirstZero(matches) : 8;
+
+        return match <= end && match < 8 ? (char *)word + match : NULL;
+    }
+}
+
+char *strrchr(const char *str, int c) {
+    char target = (char)c;
+    const char *last = NULL;
+
+    /* The end has to be found anyway, then search backwards from it */
+    const char *end = str + strlen(str);
+    if (!target) return (char *)end;
+
+    for (const char *p = end; p > str;) {
+        p--;
+        if (*p == target) {
+            last = p;
+            break;
+        }
+    }
 
-    return tmp;
+    return (char *)last;
 }
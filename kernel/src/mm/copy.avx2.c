@@ -0,0 +1,72 @@
+/*
+    * copy.avx2.c
+    * Bulk copy with AVX2, only called between KernelFpuBegin/KernelFpuEnd
+    * Created 17/10/2026
+*/
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long long v4di __attribute__((vector_size(32)));
+typedef long long v4di_unaligned __attribute__((vector_size(32), aligned(1), may_alias));
+
+/* Copies at least this big bypass the cache on the way out, they would only evict everything else */
+#define NONTEMPORAL_THRESHOLD 0x100000
+
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+void CopyAVX2(void *destination, const void *source, size_t n)
+{
+    unsigned char *d = destination;
+    const unsigned char *s = source;
+
+    if (n >= NONTEMPORAL_THRESHOLD) {
+        /* Streaming stores need an aligned destination */
+        while ((uintptr_t)d & 31) {
+            *d++ = *s++;
+            n--;
+        }
+
+        while (n >= 128) {
+            v4di a = ((const v4di_unaligned *)s)[0];
+            v4di b = ((const v4di_unaligned *)s)[1];
+            v4di c = ((const v4di_unaligned *)s)[2];
+            v4di e = ((const v4di_unaligned *)s)[3];
+
+            __builtin_ia32_movntdq256((v4di *)d, a);
+            __builtin_ia32_movntdq256((v4di *)d + 1, b);
+            __builtin_ia32_movntdq256((v4di *)d + 2, c);
+            __builtin_ia32_movntdq256((v4di *)d + 3, e);
+
+            d += 128;
+            s += 128;
+            n -= 128;
+        }
+
+        /* Streaming stores are weakly ordered, make them visible before anything that follows */
+        __builtin_ia32_sfence();
+    }
+
+    while (n >= 128) {
+        v4di a = ((const v4di_unaligned *)s)[0];
+        v4di b = ((const v4di_unaligned *)s)[1];
+        v4di c = ((const v4di_unaligned *)s)[2];
+        v4di e = ((const v4di_unaligned *)s)[3];
+
+        ((v4di_unaligned *)d)[0] = a;
+        ((v4di_unaligned *)d)[1] = b;
+        ((v4di_unaligned *)d)[2] = c;
+        ((v4di_unaligned *)d)[3] = e;
+
+        d += 128;
+        s += 128;
+        n -= 128;
+    }
+
+    while (n >= 32) {
+        *(v4di_unaligned *)d = *(const v4di_unaligned *)s;
+        d += 32;
+        s += 32;
+        n -= 32;
+    }
+
+    while (n--) *d++ = *s++;
+}
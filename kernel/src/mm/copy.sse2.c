@@ -0,0 +1,42 @@
+/*
+    * copy.sse2.c
+    * Bulk copy with SSE2, only called between KernelFpuBegin/KernelFpuEnd
+    * Created 17/10/2026
+*/
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long long v2di __attribute__((vector_size(16), aligned(1), may_alias));
+
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+void CopySSE2(void *destination, const void *source, size_t n)
+{
+    unsigned char *d = destination;
+    const unsigned char *s = source;
+
+    /* Four 16 byte registers in flight per iteration */
+    while (n >= 64) {
+        v2di a = ((const v2di *)s)[0];
+        v2di b = ((const v2di *)s)[1];
+        v2di c = ((const v2di *)s)[2];
+        v2di e = ((const v2di *)s)[3];
+
+        ((v2di *)d)[0] = a;
+        ((v2di *)d)[1] = b;
+        ((v2di *)d)[2] = c;
+        ((v2di *)d)[3] = e;
+
+        d += 64;
+        s += 64;
+        n -= 64;
+    }
+
+    while (n >= 16) {
+        *(v2di *)d = *(const v2di *)s;
+        d += 16;
+        s += 16;
+        n -= 16;
+    }
+
+    while (n--) *d++ = *s++;
+}
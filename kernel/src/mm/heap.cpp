@@ -2,123 +2,523 @@
     * heap.cpp
     * Implements a heap memory allocator.
     * Created 16/09/2023 DanielH
+    * Segregated fit with coalescing 17/10/2026
+    * Dedicated virtual range 17/10/2026
 */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <mm/pmm.hpp>
 #include <mm/mem.hpp>
 #include <mm/heap.hpp>
+#include <mm/slab.hpp>
 #include <terminal/terminal.hpp>
 #include <hal/spinlock.hpp>
 #include <hal/vmm.hpp>
+#include <hal/cpu.hpp>
+#include <hal/tlb.hpp>
+#include <sched/preempt.hpp>
+#include <libs/kernel.hpp>
 
-struct Node {
-    size_t size;
+/*
+    Two-level segregated fit (TLSF). Free blocks are binned by size: the first
+    level is the power of two, the second splits each power of two into 16
+    linear steps. A bitmap per level means finding a free block big enough is
+    a couple of bit scans, and requests are rounded up to the next bin so any
+    block in that bin fits without walking the list.
+
+    Every block starts with a boundary tag holding its own size and the size
+    of the block physically before it, so a freed block can be merged with
+    both of its neighbours in O(1).
+
+    The heap lives in its own virtual range, [KernelHeapBase, HeapTop) is
+    mapped and the last 16 bytes are a zero sized sentinel block. Growing
+    maps more frames on top, which need not be physically contiguous. When
+    a big enough free block ends up at the top, the heap shrinks again and
+    its frames go back to the PMM.
+*/
+constexpr size_t HeapAlign = 16;
+constexpr size_t SLLog2 = 4;
+constexpr size_t SLCount = 1 << SLLog2;
+constexpr size_t FLShift = SLLog2 + 4; // Blocks below 256 bytes all live in first level 0, in 16 byte steps
+constexpr size_t SmallBlockSize = (size_t)1 << FLShift;
+constexpr size_t FLCount = 32;
 
-    Node *next;
+/* Grow by at least 256 KiB, or a quarter of the current heap, at a time */
+constexpr size_t MinHeapGrowth = 0x40000;
+/* Frames mapped per MapPages call when growing, or unmapped per UnmapRange call when trimming */
+constexpr size_t MapBatch = 64;
+/* A free block this big at the top of the heap is cut down to MinHeapGrowth and the rest handed back */
+constexpr size_t TrimThreshold = MinHeapGrowth * 4;
+
+struct BlockHeader {
+    size_t PrevSize; // 0 for the first block of a region
+    size_t Size;     // Includes the header, bit 0 is set while the block is free
+};
+
+/* Free blocks keep their list links in the payload, which sets the minimum block size */
+struct FreeBlockHeader : BlockHeader {
+    FreeBlockHeader *Next;
+    FreeBlockHeader *Prev;
 };
 
-static Node head = {0, 0};
+constexpr size_t BlockFree = 1;
+constexpr size_t MinBlockSize = sizeof(FreeBlockHeader);
+
+static FreeBlockHeader *FreeLists[FLCount][SLCount];
+static uint32_t FLBitmap = 0;
+static uint16_t SLBitmap[FLCount];
 
-static void InsertNode(void *base, size_t size) {
-    // Insert at the very beginning
-    Node *node = (Node *)base;
+static uintptr_t HeapTop = KernelHeapBase;
 
-    node->size = size;
-    node->next = head.next;
-    head.next = node;
+/* Statistics */
+static size_t HeapSize = 0;
+static size_t FreeSize = 0;
+static size_t FreeBlockCount = 0;
+
+/* Queued, every CPU that misses its slab magazines ends up here */
+static Kernel::QueuedSpinlock HeapLock("Heap");
+
+/* Set while a trim or a failed expansion unmaps the range above HeapTop with the lock dropped, growing has to wait for it */
+static volatile bool Trimming = false;
+
+static inline size_t SizeOf(BlockHeader *block) {
+    return block->Size & ~BlockFree;
+}
+
+static inline bool IsFree(BlockHeader *block) {
+    return block->Size & BlockFree;
+}
+
+static inline BlockHeader *NextBlock(BlockHeader *block) {
+    return (BlockHeader *)((uintptr_t)block + SizeOf(block));
 }
 
-static size_t ExpandHeap(size_t pageCount) {
-    /* The physical memory manager returns physical memory addresss. */
-    void *start = (void *)HHDMPhysToVirt((uintptr_t)Kernel::Mem::AllocatePage());
-    if (!start) return 0;
+static inline BlockHeader *PrevBlock(BlockHeader *block) {
+    return (BlockHeader *)((uintptr_t)block - block->PrevSize);
+}
 
-    size_t i;
-    for (i = 0; i < pageCount - 1; i++) {
-        if (!Kernel::Mem::AllocatePage()) break;
+static inline unsigned int Log2(size_t value) {
+    return 63 - __builtin_clzl(value);
+}
+
+/* Bin a block of this size belongs to */
+static void MapSize(size_t size, unsigned int *fl, unsigned int *sl) {
+    if (size < SmallBlockSize) {
+        *fl = 0;
+        *sl = size / (SmallBlockSize / SLCount);
+    } else {
+        unsigned int log = Log2(size);
+        *fl = log - FLShift + 1;
+        *sl = (size >> (log - SLLog2)) ^ SLCount;
     }
+}
+
+/* First bin whose blocks are all at least this big */
+static void MapSizeRoundUp(size_t size, unsigned int *fl, unsigned int *sl) {
+    if (size >= SmallBlockSize) size += ((size_t)1 << (Log2(size) - SLLog2)) - 1;
 
-    InsertNode(start, (i + 1) * 4096);
-    return i + 1;
+    MapSize(size, fl, sl);
 }
 
-static Node *FindSuitableNode(size_t size) {
-    Node *current = &head;
+static void InsertFree(BlockHeader *block) {
+    unsigned int fl, sl;
+    MapSize(SizeOf(block), &fl, &sl);
 
-    while (current->next != nullptr) {
-        if (current->next->size > size) {
-            if (current->next->size >= sizeof(Node) + size) {
-                Node *ret = current->next;
-                current->next = current->next->next;
+    FreeBlockHeader *free = (FreeBlockHeader *)block;
+    free->Size |= BlockFree;
+    free->Prev = nullptr;
+    free->Next = FreeLists[fl][sl];
+    if (free->Next) free->Next->Prev = free;
+    FreeLists[fl][sl] = free;
 
-                size_t requiredSize = sizeof(Node) + size;
-                uintptr_t nodeTop = (uintptr_t)ret + sizeof(Node) + size;
-                uintptr_t extraSize = ret->size - requiredSize;
+    FLBitmap |= 1u << fl;
+    SLBitmap[fl] |= 1u << sl;
 
-                if (extraSize) InsertNode((void *)nodeTop, extraSize);
+    FreeSize += SizeOf(block);
+    FreeBlockCount++;
+}
+
+static void RemoveFree(BlockHeader *block) {
+    unsigned int fl, sl;
+    MapSize(SizeOf(block), &fl, &sl);
 
-                ret->size = requiredSize;
+    FreeBlockHeader *free = (FreeBlockHeader *)block;
+    if (free->Prev) free->Prev->Next = free->Next;
+    else FreeLists[fl][sl] = free->Next;
+    if (free->Next) free->Next->Prev = free->Prev;
+
+    if (!FreeLists[fl][sl]) {
+        SLBitmap[fl] &= ~(1u << sl);
+        if (!SLBitmap[fl]) FLBitmap &= ~(1u << fl);
+    }
+
+    free->Size &= ~BlockFree;
+
+    FreeSize -= SizeOf(block);
+    FreeBlockCount--;
+}
+
+/* Finds a free block of at least size bytes in O(1), or nullptr */
+static BlockHeader *FindFree(size_t size) {
+    unsigned int fl, sl;
+    MapSizeRoundUp(size, &fl, &sl);
+    if (fl >= FLCount) return nullptr;
+
+    uint32_t slMap = SLBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint32_t flMap = fl + 1 < FLCount ? FLBitmap & (~0u << (fl + 1)) : 0;
+        if (!flMap) return nullptr;
+
+        fl = __builtin_ctz(flMap);
+        slMap = SLBitmap[fl];
+    }
 
-                return ret;
+    sl = __builtin_ctz(slMap);
+    return FreeLists[fl][sl];
+}
+
+/* Cuts a used block down to size, the tail goes back on the free lists (merged with a free neighbour after it) */
+static void SplitBlock(BlockHeader *block, size_t size) {
+    size_t remaining = SizeOf(block) - size;
+    if (remaining < MinBlockSize) return;
+
+    BlockHeader *next = NextBlock(block);
+    BlockHeader *tail = (BlockHeader *)((uintptr_t)block + size);
+
+    block->Size = size;
+    tail->PrevSize = size;
+    tail->Size = remaining;
+
+    if (IsFree(next)) {
+        RemoveFree(next);
+        tail->Size += SizeOf(next);
+        next = NextBlock(next);
+    }
+
+    next->PrevSize = SizeOf(tail);
+    InsertFree(tail);
+}
+
+static inline bool InHeap(void *object) {
+    return (uintptr_t)object >= KernelHeapBase && (uintptr_t)object < HeapTop;
+}
+
+static void FreeLocked(void *base);
+
+/* Maps at least size more bytes at the top of the heap and frees them into it, merging with the old last block */
+static bool ExpandHeap(size_t size) {
+    /* Mapping over a range that is still being trimmed would have the trim unmap the new memory */
+    while (Trimming) {
+        HeapLock.Release();
+        Kernel::VMM::ServiceTLBShootdowns();
+        Kernel::CPU::Pause();
+        HeapLock.Aquire();
+    }
+
+    size_t growth = size + sizeof(BlockHeader);
+    if (growth < MinHeapGrowth) growth = MinHeapGrowth;
+    if (growth < HeapSize / 4) growth = HeapSize / 4;
+    growth = ALIGN_UP(growth, 0x1000);
+
+    if (HeapTop + growth > KernelHeapBase + KernelHeapSize) {
+        growth = ALIGN_UP(size + sizeof(BlockHeader), 0x1000);
+        if (HeapTop + growth > KernelHeapBase + KernelHeapSize) return false;
+    }
+
+    /* Frames are gathered in batches so each batch is mapped with a single page table walk */
+    uintptr_t frames[MapBatch];
+    size_t mapped = 0;
+    while (mapped < growth) {
+        size_t count = 0;
+        while (count < MapBatch && mapped + count * 0x1000 < growth) {
+            void *page = Kernel::Mem::AllocatePage(Kernel::Mem::PAGE_ALLOC_NO_ZERO);
+            if (!page) break;
+            Kernel::Mem::SetPageOwner(page, Kernel::Mem::PAGE_OWNER_HEAP);
+
+            frames[count++] = (uintptr_t)page;
+        }
+
+        if (count && Kernel::VMM::MapPages(nullptr, HeapTop + mapped, frames, count, Kernel::VMM::MAP_WRITE) != Kernel::VMM::MAP_OK) {
+            /*
+                Part of the batch may have been mapped before MapPages ran out of page tables. That
+                has to be unmapped before the frames are reused, and like a trim the shootdown waits
+                on the other CPUs, so it's done without the lock while growing and trimming wait.
+            */
+            Kernel::Sched::PreemptDisable();
+            Trimming = true;
+            HeapLock.Release();
+
+            if (Kernel::VMM::UnmapRange(nullptr, HeapTop + mapped, count * 0x1000) != Kernel::VMM::MAP_OK) {
+                Kernel::Panic("[HEAP] Unable to unmap a failed heap expansion.");
             }
 
+            for (size_t i = 0; i < count; i++) Kernel::Mem::FreePage((void *)frames[i]);
+
+            __atomic_store_n(&Trimming, false, __ATOMIC_RELEASE);
+            Kernel::Sched::PreemptEnable();
+            HeapLock.Aquire();
+            break;
+        }
+
+        mapped += count * 0x1000;
+        if (count < MapBatch) break;
+    }
+
+    /* Out of memory part way through, keep whatever was mapped but only report success if the request fits */
+    if (!mapped) return false;
+
+    /* The new memory starts where the old sentinel was (or at the very bottom the first time round) */
+    BlockHeader *block;
+    if (HeapTop == KernelHeapBase) {
+        block = (BlockHeader *)KernelHeapBase;
+        block->PrevSize = 0;
+        block->Size = mapped - sizeof(BlockHeader);
+    } else {
+        block = (BlockHeader *)(HeapTop - sizeof(BlockHeader));
+        block->Size = mapped;
+    }
+
+    HeapTop += mapped;
+    HeapSize += mapped;
+
+    BlockHeader *sentinel = (BlockHeader *)(HeapTop - sizeof(BlockHeader));
+    sentinel->PrevSize = SizeOf(block);
+    sentinel->Size = 0;
+
+    /* Freeing the new block merges it with a free block before it */
+    FreeLocked((void *)((uintptr_t)block + sizeof(BlockHeader)));
+
+    return mapped >= size + sizeof(BlockHeader);
+}
+
+static inline size_t BlockSizeFor(size_t size) {
+    size_t blockSize = ALIGN_UP(size, HeapAlign) + sizeof(BlockHeader);
+    return blockSize < MinBlockSize ? MinBlockSize : blockSize;
+}
+
+/* The allocator proper, called with HeapLock held */
+static void *AllocateLocked(size_t size) {
+    size_t blockSize = BlockSizeFor(size);
+
+    BlockHeader *block = FindFree(blockSize);
+    if (!block) {
+        ExpandHeap(blockSize);
+        block = FindFree(blockSize);
+        if (!block) return nullptr;
+    }
+
+    RemoveFree(block);
+    SplitBlock(block, blockSize);
+
+    return (void *)((uintptr_t)block + sizeof(BlockHeader));
+}
+
+static void FreeLocked(void *base) {
+    BlockHeader *block = (BlockHeader *)((uintptr_t)base - sizeof(BlockHeader));
+    if (IsFree(block)) Kernel::Panic("[HEAP] Double free of a heap block.");
+
+    BlockHeader *next = NextBlock(block);
+    if (IsFree(next)) {
+        RemoveFree(next);
+        block->Size += SizeOf(next);
+    }
+
+    if (block->PrevSize) {
+        BlockHeader *prev = PrevBlock(block);
+        if (IsFree(prev)) {
+            RemoveFree(prev);
+            prev->Size += SizeOf(block);
+            block = prev;
         }
-        current = current->next;
     }
 
-    // No suitable node found
-    if (!ExpandHeap(10)) return nullptr; // Expand by 10 pages (0x1000 * 10), if that memory is not available we will get more anyway.
-    return FindSuitableNode(size);
+    NextBlock(block)->PrevSize = SizeOf(block);
+    InsertFree(block);
+}
+
+/*
+    Cuts a large free block at the top of the heap down, lowering HeapTop. Returns
+    the range above the new top in base/end, to be unmapped with ReleaseTrimmed
+    once the lock is dropped, since that waits on the other CPUs. Preemption stays
+    disabled until then: growing spins on Trimming with interrupts off, so a thread
+    switched out mid-trim would hang any other thread growing the heap on its CPU.
+*/
+static bool TrimLocked(uintptr_t *base, uintptr_t *end) {
+    if (Trimming) return false;
+
+    BlockHeader *sentinel = (BlockHeader *)(HeapTop - sizeof(BlockHeader));
+    BlockHeader *last = PrevBlock(sentinel);
+    if (!IsFree(last) || SizeOf(last) < TrimThreshold) return false;
+
+    uintptr_t newTop = ALIGN_UP((uintptr_t)last + MinHeapGrowth, 0x1000);
+
+    RemoveFree(last);
+    last->Size = newTop - sizeof(BlockHeader) - (uintptr_t)last;
+    InsertFree(last);
+
+    sentinel = (BlockHeader *)(newTop - sizeof(BlockHeader));
+    sentinel->PrevSize = SizeOf(last);
+    sentinel->Size = 0;
+
+    *base = newTop;
+    *end = HeapTop;
+
+    HeapSize -= HeapTop - newTop;
+    HeapTop = newTop;
+    Kernel::Sched::PreemptDisable();
+    Trimming = true;
+
+    return true;
+}
+
+/* Unmaps a trimmed range and gives its frames back, called without the heap lock */
+static void ReleaseTrimmed(uintptr_t base, uintptr_t end) {
+    uintptr_t frames[MapBatch];
+
+    for (uintptr_t virt = base; virt < end; virt += MapBatch * 0x1000) {
+        size_t count = (end - virt) / 0x1000;
+        if (count > MapBatch) count = MapBatch;
+
+        if (Kernel::VMM::UnmapRange(nullptr, virt, count * 0x1000, frames) != Kernel::VMM::MAP_OK) {
+            Kernel::Panic("[HEAP] Unable to unmap trimmed heap memory.");
+        }
+
+        /* No CPU can reach these through the TLB any more */
+        for (size_t i = 0; i < count; i++) {
+            if (frames[i]) Kernel::Mem::FreePage((void *)frames[i]);
+        }
+    }
+
+    __atomic_store_n(&Trimming, false, __ATOMIC_RELEASE);
+    Kernel::Sched::PreemptEnable();
 }
 
 namespace Kernel::Mem {
     void InitializeHeap(size_t heapSize) {
         if (!heapSize) return;
-        size_t pages = heapSize / 4096;
 
-        if (ExpandHeap(pages) < pages) {
-            Log(KERNEL_LOG_DEBUG, "Warning: Initial heap size request was not met (%d pages).", heapSize);
+        uint64_t flags = HeapLock.AquireIrqSave();
+        bool expanded = ExpandHeap(heapSize);
+        HeapLock.ReleaseIrqRestore(flags);
+
+        if (!expanded) {
+            Log(KERNEL_LOG_DEBUG, "Warning: Initial heap size request was not met (%d pages).", heapSize / 0x1000);
         }
     }
 
-    SPINLOCK_CREATE(malloc_spinlock);
     void *Allocate(size_t size) {
-        SpinlockAquire(&malloc_spinlock);
-        Node *node = FindSuitableNode(size);
-        SpinlockRelease(&malloc_spinlock);
+        /* Small objects go to the slab size classes and their per-CPU magazines, which don't need the heap lock */
+        if (size <= MaxSlabObjectSize) {
+            void *object = SlabAllocate(size);
+            if (object) return object;
+        }
 
-        return (void *)((uintptr_t)node + sizeof(Node));
+        uint64_t flags = HeapLock.AquireIrqSave();
+        void *object = AllocateLocked(size);
+        HeapLock.ReleaseIrqRestore(flags);
+
+        return object;
     }
 
-    SPINLOCK_CREATE(free_spinlock);
     void Free(void *base) {
-        SpinlockAquire(&free_spinlock);
-        Node *node = (Node *)((uintptr_t)base - sizeof(Node));
-        InsertNode((void *)node, node->size);
-        SpinlockRelease(&free_spinlock);
+        if (!base) return;
+
+        /* Small objects from operator new live in the slab size classes */
+        if (!InHeap(base)) {
+            if (!IsSlabObject(base)) Panic("[HEAP] Attempted to free memory that isn't from the heap.");
+
+            SlabFree(base);
+            return;
+        }
+
+        uintptr_t trimBase, trimEnd;
+
+        uint64_t flags = HeapLock.AquireIrqSave();
+        FreeLocked(base);
+        bool trimmed = TrimLocked(&trimBase, &trimEnd);
+        HeapLock.ReleaseIrqRestore(flags);
+
+        if (trimmed) ReleaseTrimmed(trimBase, trimEnd);
     }
 
-    SPINLOCK_CREATE(realloc_spinlock);
     void *Reallocate(void *object, size_t new_size) {
-        SpinlockAquire(&realloc_spinlock);
+        if (!object) return Allocate(new_size);
+
+        if (!InHeap(object)) {
+            if (!IsSlabObject(object)) Panic("[HEAP] Attempted to reallocate memory that isn't from the heap.");
+
+            size_t old_size = SlabObjectSize(object);
+            if (new_size <= old_size) return object;
 
-        /* Gets the object's frame struct in the freelist (it is placed right before the block actually starts)*/
-        Node *node = (Node *)((uintptr_t)object - sizeof(Node));
-        /* Size of block is calculated by requested size + sizeof(Node) to fit both the frame and the block */
-        size_t old_size = node->size - sizeof(Node); 
+            void *new_object = SlabAllocate(new_size);
+            if (!new_object) new_object = Allocate(new_size);
+            if (!new_object) return nullptr;
 
-        void *new_object = Allocate(new_size);
-        if (!new_object) {
-            goto cleanup;
+            memcpy(new_object, object, old_size);
+            SlabFree(object);
+            return new_object;
         }
 
-        memcpy(new_object, object, old_size);
+        uint64_t flags = HeapLock.AquireIrqSave();
 
-        Free(object);
+        BlockHeader *block = (BlockHeader *)((uintptr_t)object - sizeof(BlockHeader));
+        size_t blockSize = BlockSizeFor(new_size);
+        size_t old_size = SizeOf(block) - sizeof(BlockHeader);
+        void *new_object = object;
+
+        if (blockSize <= SizeOf(block)) {
+            /* Shrinking (or already big enough), give the tail back */
+            SplitBlock(block, blockSize);
+        } else if (IsFree(NextBlock(block)) && SizeOf(block) + SizeOf(NextBlock(block)) >= blockSize) {
+            /* Grow in place into the free block after this one */
+            BlockHeader *next = NextBlock(block);
+            RemoveFree(next);
+            block->Size += SizeOf(next);
+            NextBlock(block)->PrevSize = SizeOf(block);
+            SplitBlock(block, blockSize);
+        } else {
+            new_object = AllocateLocked(new_size);
+            if (new_object) {
+                memcpy(new_object, object, old_size);
+                FreeLocked(object);
+            }
+        }
+
+        HeapLock.ReleaseIrqRestore(flags);
 
-cleanup:
-        SpinlockRelease(&realloc_spinlock);
         return new_object;
     }
+
+    HeapStatistics GetHeapStatistics() {
+        uint64_t flags = HeapLock.AquireIrqSave();
+
+        HeapStatistics stats = {
+            .HeapSize = HeapSize,
+            .FreeSize = FreeSize,
+            .FreeBlocks = FreeBlockCount,
+            .LargestFreeBlock = 0,
+            .Fragmentation = 0
+        };
+
+        /* The largest free block is in the highest non-empty bin */
+        size_t largest = 0;
+        if (FLBitmap) {
+            unsigned int fl = Log2(FLBitmap);
+            unsigned int sl = Log2(SLBitmap[fl]);
+
+            for (FreeBlockHeader *block = FreeLists[fl][sl]; block; block = block->Next) {
+                if (SizeOf(block) > largest) largest = SizeOf(block);
+            }
+        }
+
+        HeapLock.ReleaseIrqRestore(flags);
+
+        if (largest) stats.LargestFreeBlock = largest - sizeof(BlockHeader);
+
+        /* How much of the free memory can't be handed out as one allocation, in percent */
+        if (stats.FreeSize) stats.Fragmentation = 100 - (largest * 100 / stats.FreeSize);
+
+        return stats;
+    }
 }
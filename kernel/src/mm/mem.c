@@ -2,29 +2,208 @@
     * mem.c
     * Memory functions
     * Created 02/09/2023
+    * rep movsb/stosb and word-at-a-time versions 17/10/2026
 */
 #include <stddef.h>
+#include <stdint.h>
+#include <cpuid.h>
 
-void *memcpy(char *destination, char *source, size_t n)
+/*
+    With ERMS (enhanced rep movsb/stosb) the string instructions move whole
+    cache lines internally and beat anything we could write by hand, past a
+    startup cost of a few dozen cycles. FSRM (fast short rep mov) makes that
+    startup cost go away for short copies too. Without either, copies go a
+    64-bit word at a time, or through the vector registers when big enough.
+
+    GCC recognises the word loops below as memcpy/memset and would happily turn
+    them into calls to themselves, hence no-tree-loop-distribute-patterns.
+*/
+#define MEM_FUNCTION __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+/* Below this, without FSRM, a word loop is done before rep movsb/stosb gets going */
+#define REP_THRESHOLD 128
+
+/*
+    Copies at least this big go through the vector unit (copy.sse2.c/copy.avx2.c)
+    when rep movsb isn't fast, saving the extended state costs too much below it.
+    Copies big enough for AVX2 non-temporal stores always do.
+*/
+#define SIMD_COPY_THRESHOLD 0x1000
+#define NONTEMPORAL_COPY_THRESHOLD 0x100000
+
+enum { SIMD_NONE, SIMD_SSE2, SIMD_AVX2 }; // Kernel::CPU::SIMDLevel
+
+extern int GetSIMDLevel(void);
+extern void KernelFpuBegin(void);
+extern void KernelFpuEnd(void);
+extern void CopySSE2(void *destination, const void *source, size_t n);
+extern void CopyAVX2(void *destination, const void *source, size_t n);
+
+typedef uint64_t __attribute__((may_alias, aligned(1))) unaligned_u64;
+
+enum {
+    MEM_FEATURES_UNKNOWN = 0,
+    MEM_FEATURES_DETECTED = 1 << 0,
+    MEM_FEATURE_ERMS = 1 << 1,
+    MEM_FEATURE_FSRM = 1 << 2,
+};
+
+static int MemFeatures = MEM_FEATURES_UNKNOWN;
+
+static int DetectMemFeatures(void) {
+    unsigned int eax, ebx, ecx, edx;
+    int features = MEM_FEATURES_DETECTED;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        if (ebx & (1 << 9)) features |= MEM_FEATURE_ERMS;
+        if (edx & (1 << 4)) features |= MEM_FEATURE_FSRM;
+    }
+
+    MemFeatures = features;
+    return features;
+}
+
+static inline int GetMemFeatures(void) {
+    int features = MemFeatures;
+    return features ? features : DetectMemFeatures();
+}
+
+/* Whether rep movsb is the best way to copy n bytes */
+static inline int UseRepMovsb(size_t n) {
+    int features = GetMemFeatures();
+    return (features & MEM_FEATURE_FSRM) || ((features & MEM_FEATURE_ERMS) && n >= REP_THRESHOLD);
+}
+
+/* Copies with the vector unit if that beats the alternatives for n bytes, returns whether it did */
+static inline int SIMDCopy(void *destination, const void *source, size_t n) {
+    if (n < SIMD_COPY_THRESHOLD) return 0;
+
+    int level = GetSIMDLevel();
+    int erms = GetMemFeatures() & MEM_FEATURE_ERMS;
+
+    if (level == SIMD_AVX2 && (!erms || n >= NONTEMPORAL_COPY_THRESHOLD)) {
+        KernelFpuBegin();
+        CopyAVX2(destination, source, n);
+        KernelFpuEnd();
+        return 1;
+    }
+
+    if (level == SIMD_SSE2 && !erms) {
+        KernelFpuBegin();
+        CopySSE2(destination, source, n);
+        KernelFpuEnd();
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline int UseRepStosb(size_t n) {
+    return (GetMemFeatures() & MEM_FEATURE_ERMS) && n >= REP_THRESHOLD;
+}
+
+/* Forward copy a word at a time, safe for overlapping buffers as long as destination is below source */
+MEM_FUNCTION static void CopyForward(unsigned char *destination, const unsigned char *source, size_t n) {
+    while (n >= 8) {
+        *(unaligned_u64 *)destination = *(const unaligned_u64 *)source;
+        destination += 8;
+        source += 8;
+        n -= 8;
+    }
+
+    while (n--) *destination++ = *source++;
+}
+
+MEM_FUNCTION static void CopyBackward(unsigned char *destination, const unsigned char *source, size_t n) {
+    destination += n;
+    source += n;
+
+    while (n >= 8) {
+        destination -= 8;
+        source -= 8;
+        n -= 8;
+        *(unaligned_u64 *)destination = *(const unaligned_u64 *)source;
+    }
+
+    while (n--) *--destination = *--source;
+}
+
+MEM_FUNCTION void *memcpy(void *restrict destination, const void *restrict source, size_t n)
+{
+    if (SIMDCopy(destination, source, n)) return destination;
+
+    if (UseRepMovsb(n)) {
+        void *d = destination;
+        asm volatile ("rep movsb" : "+D"(d), "+S"(source), "+c"(n) : : "memory");
+        return destination;
+    }
+
+    CopyForward(destination, source, n);
+    return destination;
+}
+
+MEM_FUNCTION void *memmove(void *destination, const void *source, size_t n)
 {
-    size_t i = 0;
+    unsigned char *d = destination;
+    const unsigned char *s = source;
 
-    while (i < n) {
-        destination[i] = source[i];
+    if (d == s || !n) return destination;
 
-        i++;
+    /* Copying forwards is fine unless the destination starts inside the source */
+    if (d < s || d >= s + n) {
+        if ((d + n <= s || d >= s + n) && SIMDCopy(d, s, n)) return destination;
+
+        if (UseRepMovsb(n)) {
+            asm volatile ("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+            return destination;
+        }
+
+        CopyForward(d, s, n);
+        return destination;
     }
 
+    /* Backwards rep movsb (with the direction flag set) isn't fast on anything, use words */
+    CopyBackward(d, s, n);
     return destination;
 }
 
-void *memset(void *destination, int val, size_t n)
+MEM_FUNCTION void *memset(void *destination, int val, size_t n)
 {
-    volatile unsigned char *buf = (volatile unsigned char *)destination;
+    if (UseRepStosb(n)) {
+        void *d = destination;
+        asm volatile ("rep stosb" : "+D"(d), "+c"(n) : "a"(val) : "memory");
+        return destination;
+    }
 
-    for (size_t i = 0; i < n; i++) {
-        buf[i] = (unsigned char)val;
+    unsigned char *buf = destination;
+    uint64_t word = 0x0101010101010101ULL * (unsigned char)val;
+
+    while (n >= 8) {
+        *(unaligned_u64 *)buf = word;
+        buf += 8;
+        n -= 8;
     }
 
+    while (n--) *buf++ = (unsigned char)val;
+
     return destination;
 }
+
+MEM_FUNCTION int memcmp(const void *buffer1, const void *buffer2, size_t n)
+{
+    const unsigned char *a = buffer1;
+    const unsigned char *b = buffer2;
+
+    /* Skip over equal words, the first differing word is compared bytewise below */
+    while (n >= 8 && *(const unaligned_u64 *)a == *(const unaligned_u64 *)b) {
+        a += 8;
+        b += 8;
+        n -= 8;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return a[i] - b[i];
+    }
+
+    return 0;
+}
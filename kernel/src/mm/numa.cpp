@@ -0,0 +1,278 @@
+/*
+    * numa.cpp
+    * NUMA topology from the ACPI SRAT and SLIT
+    * Created 17/10/2026
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mm/numa.hpp>
+#include <mm/pmm.hpp>
+#include <hal/acpi.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <terminal/terminal.hpp>
+
+using Kernel::ACPI::SDTHeader;
+using namespace Kernel::Mem;
+
+/* System Resource Affinity Table */
+struct SRATHeader {
+    SDTHeader StandardHeader;
+    uint32_t Reserved0; // Must be 1
+    uint64_t Reserved1;
+}__attribute__((packed));
+
+enum SRATEntryType : uint8_t {
+    SRAT_LAPIC_AFFINITY = 0,
+    SRAT_MEMORY_AFFINITY = 1,
+    SRAT_X2APIC_AFFINITY = 2,
+};
+
+struct SRATLAPICAffinity {
+    uint8_t Type;
+    uint8_t Length;
+    uint8_t ProximityDomainLow;
+    uint8_t APICId;
+    uint32_t Flags; // Bit 0: enabled
+    uint8_t SAPICEId;
+    uint8_t ProximityDomainHigh[3];
+    uint32_t ClockDomain;
+}__attribute__((packed));
+
+struct SRATMemoryAffinity {
+    uint8_t Type;
+    uint8_t Length;
+    uint32_t ProximityDomain;
+    uint16_t Reserved0;
+    uint64_t Base;
+    uint64_t Size;
+    uint32_t Reserved1;
+    uint32_t Flags; // Bit 0: enabled, bit 1: hot pluggable, bit 2: non-volatile
+    uint64_t Reserved2;
+}__attribute__((packed));
+
+struct SRATX2APICAffinity {
+    uint8_t Type;
+    uint8_t Length;
+    uint16_t Reserved0;
+    uint32_t ProximityDomain;
+    uint32_t X2APICId;
+    uint32_t Flags; // Bit 0: enabled
+    uint32_t ClockDomain;
+    uint32_t Reserved1;
+}__attribute__((packed));
+
+/* System Locality Information Table, a LocalityCount x LocalityCount matrix of relative distances */
+struct SLITHeader {
+    SDTHeader StandardHeader;
+    uint64_t LocalityCount;
+    uint8_t Entries[];
+}__attribute__((packed));
+
+/* Distances as defined by the SLIT, 10 is local */
+constexpr uint8_t LocalDistance = 10;
+constexpr uint8_t RemoteDistance = 20;
+
+constexpr size_t MaxMemoryRanges = 64;
+
+struct MemoryRange {
+    uintptr_t Base;
+    uintptr_t End;
+    uint8_t Node;
+};
+
+static MemoryRange MemoryRanges[MaxMemoryRanges];
+static size_t MemoryRangeCount = 0;
+
+/* Proximity domains are sparse 32-bit IDs, nodes are numbered densely in the order the SRAT lists them */
+static uint32_t NodeDomains[MaxNUMANodes];
+static size_t NodeCount = 1;
+
+static uint8_t NodeDistances[MaxNUMANodes][MaxNUMANodes];
+static uint8_t NodeFallback[MaxNUMANodes][MaxNUMANodes];
+
+static uint8_t LAPICNodes[256];
+static uint8_t CPUNodes[Kernel::CPU::MaxCPUCount];
+
+static bool SRATSeen = false;
+
+static uint8_t NodeForDomain(uint32_t domain) {
+    if (!SRATSeen) {
+        /* The first domain the SRAT mentions becomes node 0 */
+        NodeDomains[0] = domain;
+        SRATSeen = true;
+        return 0;
+    }
+
+    for (size_t i = 0; i < NodeCount; i++) {
+        if (NodeDomains[i] == domain) return i;
+    }
+
+    if (NodeCount == MaxNUMANodes) {
+        Kernel::Log(KERNEL_LOG_INFO, "[NUMA] Too many proximity domains, domain %d is treated as node 0.\n", domain);
+        return 0;
+    }
+
+    NodeDomains[NodeCount] = domain;
+    return NodeCount++;
+}
+
+static void ParseSRAT(SRATHeader *srat) {
+    uintptr_t entry = (uintptr_t)srat + sizeof(SRATHeader);
+    uintptr_t end = (uintptr_t)srat + srat->StandardHeader.Length;
+
+    while (entry + 2 <= end) {
+        uint8_t type = ((uint8_t *)entry)[0];
+        uint8_t length = ((uint8_t *)entry)[1];
+
+        if (length < 2 || entry + length > end) break;
+
+        switch (type) {
+            case SRAT_LAPIC_AFFINITY: {
+                SRATLAPICAffinity *lapic = (SRATLAPICAffinity *)entry;
+                if (!(lapic->Flags & 1)) break;
+
+                uint32_t domain = lapic->ProximityDomainLow | (lapic->ProximityDomainHigh[0] << 8) | (lapic->ProximityDomainHigh[1] << 16) | (lapic->ProximityDomainHigh[2] << 24);
+                LAPICNodes[lapic->APICId] = NodeForDomain(domain);
+                break;
+            }
+            case SRAT_X2APIC_AFFINITY: {
+                SRATX2APICAffinity *x2apic = (SRATX2APICAffinity *)entry;
+                if (!(x2apic->Flags & 1) || x2apic->X2APICId > 0xFF) break;
+
+                LAPICNodes[x2apic->X2APICId] = NodeForDomain(x2apic->ProximityDomain);
+                break;
+            }
+            case SRAT_MEMORY_AFFINITY: {
+                SRATMemoryAffinity *memory = (SRATMemoryAffinity *)entry;
+                if (!(memory->Flags & 1) || !memory->Size) break;
+
+                if (MemoryRangeCount == MaxMemoryRanges) {
+                    Kernel::Log(KERNEL_LOG_INFO, "[NUMA] Too many memory affinity ranges, ignoring the rest.\n");
+                    break;
+                }
+
+                MemoryRanges[MemoryRangeCount++] = MemoryRange {
+                    .Base = memory->Base,
+                    .End = memory->Base + memory->Size,
+                    .Node = NodeForDomain(memory->ProximityDomain)
+                };
+                break;
+            }
+        }
+
+        entry += length;
+    }
+}
+
+static void ParseSLIT(SLITHeader *slit) {
+    for (size_t from = 0; from < NodeCount; from++) {
+        for (size_t to = 0; to < NodeCount; to++) {
+            if (NodeDomains[from] >= slit->LocalityCount || NodeDomains[to] >= slit->LocalityCount) continue;
+
+            uint8_t distance = slit->Entries[NodeDomains[from] * slit->LocalityCount + NodeDomains[to]];
+
+            /* 0xFF means unreachable, keep it last in the fallback order rather than dropping it */
+            if (distance >= LocalDistance) NodeDistances[from][to] = distance;
+        }
+    }
+}
+
+/* Whether node a should be tried before node b when allocating on behalf of node. The node itself always wins ties. */
+static bool NearerThan(uint8_t node, uint8_t a, uint8_t b) {
+    if (NodeDistances[node][a] != NodeDistances[node][b]) return NodeDistances[node][a] < NodeDistances[node][b];
+    if (a == node || b == node) return a == node;
+
+    return a < b;
+}
+
+/* Orders every node by its distance from each node, nearest first. */
+static void BuildFallbackLists() {
+    for (size_t node = 0; node < NodeCount; node++) {
+        uint8_t *list = NodeFallback[node];
+
+        for (size_t i = 0; i < NodeCount; i++) {
+            uint8_t current = i;
+            size_t j = i;
+
+            while (j > 0 && NearerThan(node, current, list[j - 1])) {
+                list[j] = list[j - 1];
+                j--;
+            }
+
+            list[j] = current;
+        }
+    }
+}
+
+namespace Kernel::Mem {
+    void InitializeNUMA() {
+        SRATHeader *srat = (SRATHeader *)ACPI::GetACPITable("SRAT");
+
+        if (srat) ParseSRAT(srat);
+
+        for (size_t from = 0; from < MaxNUMANodes; from++) {
+            for (size_t to = 0; to < MaxNUMANodes; to++) {
+                NodeDistances[from][to] = from == to ? LocalDistance : RemoteDistance;
+            }
+        }
+
+        SLITHeader *slit = (SLITHeader *)ACPI::GetACPITable("SLIT");
+        if (slit && srat) ParseSLIT(slit);
+
+        BuildFallbackLists();
+
+        if (NodeCount == 1) {
+            Log(KERNEL_LOG_INFO, "[NUMA] Single memory node.\n");
+            return;
+        }
+
+        Log(KERNEL_LOG_INFO, "[NUMA] %d memory nodes%s\n", NodeCount, slit ? "" : ", no SLIT so remote nodes are all treated as equally far.");
+
+        for (size_t i = 0; i < MemoryRangeCount; i++) {
+            AssignPageNode(MemoryRanges[i].Base, MemoryRanges[i].End, MemoryRanges[i].Node);
+        }
+
+        RebuildZones();
+
+        for (size_t node = 0; node < NodeCount; node++) {
+            Log(KERNEL_LOG_INFO, "[NUMA] Node %d (domain %d): %d MiB free\n", node, NodeDomains[node], GetNodeFreeMemory(node) / 1024 / 1024);
+        }
+    }
+
+    size_t GetNodeCount() {
+        return NodeCount;
+    }
+
+    uint8_t GetNodeForAddress(uintptr_t phys) {
+        for (size_t i = 0; i < MemoryRangeCount; i++) {
+            if (phys >= MemoryRanges[i].Base && phys < MemoryRanges[i].End) return MemoryRanges[i].Node;
+        }
+
+        return 0;
+    }
+
+    uint8_t GetNodeDistance(uint8_t from, uint8_t to) {
+        if (from >= NodeCount || to >= NodeCount) return 0xFF;
+
+        return NodeDistances[from][to];
+    }
+
+    const uint8_t *GetNodeFallbackList(uint8_t node) {
+        if (node >= NodeCount) node = 0;
+
+        return NodeFallback[node];
+    }
+
+    void RegisterCPUNode(size_t cpuIndex, uint32_t lapicId) {
+        if (cpuIndex >= CPU::MaxCPUCount) return;
+
+        CPUNodes[cpuIndex] = LAPICNodes[lapicId & 0xFF];
+    }
+
+    uint8_t GetCurrentNode() {
+        if (NodeCount == 1) return 0;
+
+        return CPUNodes[CPU::GetCPUIndex()];
+    }
+}
@@ -3,90 +3,657 @@
     * Physical memory manager
     * Created 02/09/2023
     * Rewritten 19/11/2023
+    * Buddy allocator 17/10/2026
+    * NUMA zones 17/10/2026
 */
 
 #include <limine.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <mm/mem.hpp>
+#include <mm/pmm.hpp>
+#include <mm/numa.hpp>
 #include <hal/vmm.hpp>
 #include <hal/spinlock.hpp>
 #include <terminal/terminal.hpp>
+#include <libs/kernel.hpp>
+#include <hal/cpu.hpp>
+#include <hal/cpu/smp/smp.hpp>
+
+using namespace Kernel::Mem;
 
 /* System memory information */
 size_t TotalMemory = 0;
 size_t TotalUsableMemory = 0;
 
-struct PageNode {
-    size_t size;
-    PageNode *next;
+/*
+    Free blocks are linked through their own memory (via the HHDM).
+    Each order has a circular list with a static sentinel, so removing a
+    block from the middle of a list (when it merges with its buddy) is O(1).
+*/
+struct FreeBlock {
+    FreeBlock *next;
+    FreeBlock *prev;
 };
 
-PageNode head = {.size = 0, .next = 0};
+/*
+    Free memory is split into one zone per NUMA node, each with its own buddy
+    lists and lock. Until the SRAT has been parsed everything lives in node 0.
+*/
+struct Zone {
+    FreeBlock FreeLists[MaxPageOrder + 1];
+    size_t FreePages;
+    Kernel::Spinlock Lock {"PMM zone"};
+}__attribute__((aligned(64)));
+
+static Zone Zones[MaxNUMANodes] = {};
+
+/* The page frame database, one descriptor for every frame in [0, HighestAddress) */
+static PageFrame *PageFrames = nullptr;
+static uintptr_t HighestAddress = 0;
 
-static void InsertNode(void *block, size_t size) {
-    PageNode *node = (PageNode *)block;
+/* Pages currently handed out, per owner */
+static size_t OwnedPages[PAGE_OWNER_COUNT];
 
-    node->size = size;
-    node->next = head.next;
-    head.next = node;
+/*
+    Per-CPU magazines of free order 0 pages sitting in front of the buddy lists.
+    The common AllocatePage/FreePage pair only touches the calling CPU's cache,
+    which is refilled from (or drained to) the buddy allocator in batches.
+*/
+constexpr size_t PageCacheBatch = 16;
+constexpr size_t PageCacheCapacity = 64;
+
+struct PageCache {
+    size_t Count;
+    uintptr_t Pages[PageCacheCapacity];
+}__attribute__((aligned(64)));
+
+static PERCPU_CREATE(PageCache, PageCaches);
+
+/*
+    Pages that have already been zeroed by an idle CPU, so a zeroed
+    allocation doesn't have to clear 4 KiB on the caller's critical path.
+    One pool per node, an idle CPU only fills its own node's pool.
+*/
+constexpr size_t ZeroedPoolCapacity = 256;
+
+struct ZeroedPool {
+    uintptr_t Pages[ZeroedPoolCapacity];
+    volatile size_t Count;
+    Kernel::Spinlock Lock {"Zeroed pages"};
+};
+
+static ZeroedPool ZeroedPools[MaxNUMANodes] = {};
+
+static inline size_t BlockSize(unsigned int order) {
+    return (size_t)0x1000 << order;
 }
 
-static void *RemovePage() {
-    if (head.next) {
-        PageNode *ret = head.next;
-        head.next = ret->next;
+static inline PageFrame *FrameOf(uintptr_t phys) {
+    return &PageFrames[phys >> 12];
+}
 
-        if (ret->size > 4096) {
-            InsertNode((void *)((uintptr_t)ret + 4096), ret->size - 4096);
-            ret->size = 4096;
-        }
+static inline Zone *ZoneOf(uintptr_t phys) {
+    return &Zones[FrameOf(phys)->Node];
+}
+
+/* Must be called with the block's zone locked */
+static void InsertBlock(uintptr_t phys, unsigned int order) {
+    FreeBlock *block = (FreeBlock *)HHDMPhysToVirt(phys);
+    FreeBlock *list = &ZoneOf(phys)->FreeLists[order];
+
+    block->next = list->next;
+    block->prev = list;
+    list->next->prev = block;
+    list->next = block;
+
+    PageFrame *frame = FrameOf(phys);
+    frame->Flags = PAGE_FRAME_FREE;
+    frame->Order = order;
+    frame->Owner = PAGE_OWNER_NONE;
+    frame->RefCount = 0;
+}
+
+static void RemoveBlock(uintptr_t phys) {
+    FreeBlock *block = (FreeBlock *)HHDMPhysToVirt(phys);
+
+    block->prev->next = block->next;
+    block->next->prev = block->prev;
 
-        return ret;
+    FrameOf(phys)->Flags &= ~PAGE_FRAME_FREE;
+}
+
+/*
+    Returns a block to its zone's free lists, merging it with its buddy for as long as the buddy
+    is free too. Buddies on another node are never merged. Must be called with the zone locked.
+*/
+static void ReleaseBlock(uintptr_t phys, unsigned int order) {
+    uint8_t node = FrameOf(phys)->Node;
+    Zones[node].FreePages += (size_t)1 << order;
+
+    while (order < MaxPageOrder) {
+        uintptr_t buddy = phys ^ BlockSize(order);
+
+        if (buddy + BlockSize(order) > HighestAddress) break;
+
+        PageFrame *buddyFrame = FrameOf(buddy);
+        if (!(buddyFrame->Flags & PAGE_FRAME_FREE) || buddyFrame->Order != order || buddyFrame->Node != node) break;
+
+        RemoveBlock(buddy);
+
+        /* The upper half stops being a head, a second free of it has to be caught */
+        FrameOf(phys | BlockSize(order))->Flags |= PAGE_FRAME_MERGED;
+
+        phys &= ~BlockSize(order);
+        order++;
+    }
+
+    InsertBlock(phys, order);
+}
+
+/* Takes a block of the requested order from a zone, splitting a larger one if needed. Returns 0 if the zone is exhausted. */
+static uintptr_t TakeBlock(Zone *zone, unsigned int order) {
+    unsigned int current = order;
+    while (current <= MaxPageOrder && zone->FreeLists[current].next == &zone->FreeLists[current]) {
+        current++;
     }
 
+    if (current > MaxPageOrder) return 0;
+
+    uintptr_t phys = HHDMVirtToPhys((uintptr_t)zone->FreeLists[current].next);
+    RemoveBlock(phys);
+
+    /* Hand the upper halves back until the block is the right size */
+    while (current > order) {
+        current--;
+        InsertBlock(phys + BlockSize(current), current);
+    }
+
+    FrameOf(phys)->Order = order;
+    zone->FreePages -= (size_t)1 << order;
+    return phys;
+}
+
+/* Marks the head frame of a block as handed out to the kernel. */
+static void ClaimBlock(uintptr_t phys, unsigned int order) {
+    PageFrame *frame = FrameOf(phys);
+
+    frame->Flags = 0;
+    frame->Order = order;
+    frame->Owner = PAGE_OWNER_KERNEL;
+    frame->RefCount = 1;
+
+    __atomic_fetch_add(&OwnedPages[PAGE_OWNER_KERNEL], (size_t)1 << order, __ATOMIC_RELAXED);
+}
+
+/* Returns why a block can't be freed, or nullptr if it's an allocated block of that order */
+static const char *CheckFreeable(uintptr_t phys, unsigned int order) {
+    if (phys & (BlockSize(order) - 1)) return "[PMM] Attempted to free a misaligned block.";
+    if (phys + BlockSize(order) > HighestAddress) return "[PMM] Attempted to free memory outside of the page frame database.";
+
+    PageFrame *frame = FrameOf(phys);
+
+    /* A block merged into a free neighbour keeps its old order, only the merged flag gives it away */
+    if (frame->Flags & (PAGE_FRAME_FREE | PAGE_FRAME_CACHED | PAGE_FRAME_MERGED)) return "[PMM] Double free of a physical page.";
+    if (frame->Flags & PAGE_FRAME_RESERVED) return "[PMM] Attempted to free a reserved physical page.";
+    if (frame->Order != order) return "[PMM] Block freed with a different order than it was allocated with.";
+
     return nullptr;
 }
 
+/* Validates a block being freed (this is where double frees are caught) and removes it from the accounting. */
+static void UnclaimBlock(uintptr_t phys, unsigned int order) {
+    const char *error = CheckFreeable(phys, order);
+    if (error) Kernel::Panic(error);
+
+    PageFrame *frame = FrameOf(phys);
+
+    __atomic_fetch_sub(&OwnedPages[frame->Owner], (size_t)1 << order, __ATOMIC_RELAXED);
+
+    frame->Owner = PAGE_OWNER_NONE;
+    frame->RefCount = 0;
+}
+
+/* ReleaseBlock with the zone lock taken, interrupts must already be disabled. */
+static void ReleaseBlockLocked(uintptr_t phys, unsigned int order) {
+    Zone *zone = ZoneOf(phys);
+
+    zone->Lock.Aquire();
+    ReleaseBlock(phys, order);
+    zone->Lock.Release();
+}
+
+/* Feeds a physical range into the allocator as the largest naturally aligned blocks that fit. */
+static void AddRegion(uintptr_t base, uintptr_t end) {
+    base = ALIGN_UP(base, 0x1000);
+    end = ALIGN_DOWN(end, 0x1000);
+
+    /* Physical address 0 doubles as the "no memory" return value, never hand it out. */
+    if (base == 0) base = 0x1000;
+
+    uint64_t flags = Kernel::CPU::SaveAndDisableInterrupts();
+
+    while (base < end) {
+        /* Split the range where it crosses into another node, so that each block lands in one zone */
+        uint8_t node = FrameOf(base)->Node;
+        uintptr_t runEnd = base + 0x1000;
+        while (runEnd < end && FrameOf(runEnd)->Node == node) runEnd += 0x1000;
+
+        Zones[node].Lock.Aquire();
+        while (base < runEnd) {
+            unsigned int order = MaxPageOrder;
+            while (order > 0 && ((base & (BlockSize(order) - 1)) || base + BlockSize(order) > runEnd)) {
+                order--;
+            }
+
+            ReleaseBlock(base, order);
+            base += BlockSize(order);
+        }
+        Zones[node].Lock.Release();
+    }
+
+    Kernel::CPU::RestoreInterrupts(flags);
+}
+
+static uintptr_t TakeZeroedPage() {
+    ZeroedPool *pool = &ZeroedPools[Kernel::Mem::GetCurrentNode()];
+    if (!pool->Count) return 0;
+
+    uintptr_t page = 0;
+    uint64_t flags = pool->Lock.AquireIrqSave();
+    if (pool->Count) page = pool->Pages[--pool->Count];
+    pool->Lock.ReleaseIrqRestore(flags);
+
+    return page;
+}
+
+/* Memory map entry types the frame database covers, everything else is MMIO or unusable. */
+static bool IsRAM(uint64_t type) {
+    switch (type) {
+        case LIMINE_MEMMAP_USABLE:
+        case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE:
+        case LIMINE_MEMMAP_ACPI_RECLAIMABLE:
+        case LIMINE_MEMMAP_ACPI_NVS:
+        case LIMINE_MEMMAP_KERNEL_AND_MODULES:
+            return true;
+        default:
+            return false;
+    }
+}
+
 namespace Kernel::Mem {
     void InitializePMM(limine_memmap_response mmap) {
+        for (size_t node = 0; node < MaxNUMANodes; node++) {
+            for (size_t i = 0; i < MaxPageOrder + 1; i++) {
+                Zones[node].FreeLists[i].next = &Zones[node].FreeLists[i];
+                Zones[node].FreeLists[i].prev = &Zones[node].FreeLists[i];
+            }
+        }
+
         for (size_t i = 0; i < mmap.entry_count; i++) {
             TotalMemory += mmap.entries[i]->length;
-            switch (mmap.entries[i]->type) {
-                case LIMINE_MEMMAP_USABLE: {
-                    TotalUsableMemory += mmap.entries[i]->length;
-                    if (mmap.entries[i]->length >= 4096) {
-                        InsertNode((void *)HHDMPhysToVirt(mmap.entries[i]->base), mmap.entries[i]->length);
-                    }
+            if (mmap.entries[i]->type == LIMINE_MEMMAP_USABLE) TotalUsableMemory += mmap.entries[i]->length;
+
+            if (IsRAM(mmap.entries[i]->type)) {
+                uintptr_t end = mmap.entries[i]->base + mmap.entries[i]->length;
+                if (end > HighestAddress) HighestAddress = ALIGN_DOWN(end, 0x1000);
+            }
+        }
+
+        /* The page frame database is carved out of the first usable region big enough to hold it */
+        size_t frameCount = HighestAddress / 0x1000;
+        size_t databaseSize = ALIGN_UP(frameCount * sizeof(PageFrame), 0x1000);
+
+        uintptr_t databaseBase = 0;
+        bool databasePlaced = false;
+        for (size_t i = 0; i < mmap.entry_count; i++) {
+            if (mmap.entries[i]->type == LIMINE_MEMMAP_USABLE && mmap.entries[i]->length >= databaseSize) {
+                databaseBase = mmap.entries[i]->base;
+                databasePlaced = true;
+                break;
+            }
+        }
+
+        if (!databasePlaced) Panic("[PMM] Not enough memory for the page frame database.");
+
+        PageFrames = (PageFrame *)HHDMPhysToVirt(databaseBase);
+
+        /* Everything starts out reserved, usable regions are then released into the buddy allocator */
+        for (size_t i = 0; i < frameCount; i++) {
+            PageFrames[i] = PageFrame {
+                .RefCount = 0,
+                .Flags = PAGE_FRAME_RESERVED,
+                .Node = 0,
+                .Order = 0,
+                .Owner = PAGE_OWNER_NONE
+            };
+        }
+
+        for (size_t i = 0; i < databaseSize / 0x1000; i++) {
+            FrameOf(databaseBase + i * 0x1000)->Owner = PAGE_OWNER_PMM;
+        }
+        OwnedPages[PAGE_OWNER_PMM] = databaseSize / 0x1000;
+
+        for (size_t i = 0; i < mmap.entry_count; i++) {
+            uintptr_t base = mmap.entries[i]->base;
+            uintptr_t end = base + mmap.entries[i]->length;
+
+            if (mmap.entries[i]->type == LIMINE_MEMMAP_KERNEL_AND_MODULES) {
+                for (uintptr_t j = ALIGN_DOWN(base, 0x1000); j < end; j += 0x1000) {
+                    FrameOf(j)->Owner = PAGE_OWNER_KERNEL;
+                    OwnedPages[PAGE_OWNER_KERNEL]++;
                 }
+                continue;
             }
+
+            if (mmap.entries[i]->type != LIMINE_MEMMAP_USABLE) continue;
+
+            if (base == databaseBase) base += databaseSize;
+
+            AddRegion(base, end);
         }
 
         /* Log system memory info */
         Log(KERNEL_LOG_INFO, "[PMM] Total system memory: %d MiB\n", TotalMemory / 1024 / 1024);
         Log(KERNEL_LOG_INFO, "[PMM] Usable system memory: %d MiB\n", TotalUsableMemory / 1024 / 1024);
+        Log(KERNEL_LOG_INFO, "[PMM] Page frame database: %d frames (%d KiB)\n", frameCount, databaseSize / 1024);
     }
 
-    SPINLOCK_CREATE(PageAlloc_Lock);
-    void *AllocatePage() {
-        SpinlockAquire(&PageAlloc_Lock);
+    unsigned int PageOrder(size_t pageCount) {
+        unsigned int order = 0;
+        while (((size_t)1 << order) < pageCount) order++;
 
-        void *page = RemovePage();
-        memset(page, 0, 0x1000);
+        return order;
+    }
 
-        void *ret = (void *)HHDMVirtToPhys((uintptr_t)page);
+    size_t GetFreeMemory() {
+        size_t pages = 0;
+        for (size_t i = 0; i < MaxNUMANodes; i++) {
+            pages += Zones[i].FreePages + ZeroedPools[i].Count;
+        }
+
+        for (size_t i = 0; i < CPU::MaxCPUCount; i++) {
+            pages += PageCaches[i].Count;
+        }
+
+        return pages * 0x1000;
+    }
+
+    /* Free memory on the node's buddy lists, pages sitting in caches aren't counted */
+    size_t GetNodeFreeMemory(uint8_t node) {
+        if (node >= MaxNUMANodes) return 0;
+
+        return Zones[node].FreePages * 0x1000;
+    }
+
+    void AssignPageNode(uintptr_t base, uintptr_t end, uint8_t node) {
+        if (node >= MaxNUMANodes) return;
+        if (end > HighestAddress) end = HighestAddress;
+
+        for (uintptr_t i = ALIGN_DOWN(base, 0x1000); i < end; i += 0x1000) {
+            FrameOf(i)->Node = node;
+        }
+    }
+
+    void RebuildZones() {
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+
+        /* Node 0 holds everything at this point. Detach its lists into one chain and start over. */
+        Zone *boot = &Zones[0];
+        FreeBlock *chain = nullptr;
+
+        boot->Lock.Aquire();
+        for (size_t i = 0; i < MaxPageOrder + 1; i++) {
+            FreeBlock *list = &boot->FreeLists[i];
+
+            while (list->next != list) {
+                FreeBlock *block = list->next;
+                list->next = block->next;
+
+                /* Not free as far as buddy merging is concerned until it's been re-added */
+                FrameOf(HHDMVirtToPhys((uintptr_t)block))->Flags &= ~PAGE_FRAME_FREE;
+
+                block->prev = nullptr;
+                block->next = chain;
+                chain = block;
+            }
+
+            list->prev = list;
+        }
+        boot->FreePages = 0;
+        boot->Lock.Release();
+
+        /* Each block goes to the zone(s) of the node(s) its frames belong to now */
+        while (chain) {
+            FreeBlock *next = chain->next;
+            uintptr_t phys = HHDMVirtToPhys((uintptr_t)chain);
+
+            AddRegion(phys, phys + BlockSize(FrameOf(phys)->Order));
+            chain = next;
+        }
+
+        CPU::RestoreInterrupts(flags);
+    }
+
+    PageFrame *GetPageFrame(uintptr_t phys) {
+        if (phys >= HighestAddress) return nullptr;
+
+        return FrameOf(phys);
+    }
+
+    void ReferencePage(void *addr) {
+        PageFrame *frame = GetPageFrame((uintptr_t)addr);
+        if (!frame || frame->Flags) Panic("[PMM] Attempted to reference a page that isn't allocated.");
+
+        __atomic_fetch_add(&frame->RefCount, 1, __ATOMIC_RELAXED);
+    }
+
+    void ReleasePage(void *addr) {
+        PageFrame *frame = GetPageFrame((uintptr_t)addr);
+        if (!frame || frame->Flags) Panic("[PMM] Attempted to release a page that isn't allocated.");
+
+        if (__atomic_sub_fetch(&frame->RefCount, 1, __ATOMIC_ACQ_REL) == 0) {
+            if (frame->Order) FreePages(addr, frame->Order);
+            else FreePage(addr);
+        }
+    }
+
+    void SetPageOwner(void *addr, PageOwner owner) {
+        PageFrame *frame = GetPageFrame((uintptr_t)addr);
+        if (!frame || frame->Flags || owner >= PAGE_OWNER_COUNT) return;
+
+        size_t pages = (size_t)1 << frame->Order;
+        __atomic_fetch_sub(&OwnedPages[frame->Owner], pages, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&OwnedPages[owner], pages, __ATOMIC_RELAXED);
+
+        frame->Owner = owner;
+    }
+
+    size_t GetOwnedMemory(PageOwner owner) {
+        if (owner >= PAGE_OWNER_COUNT) return 0;
+
+        return OwnedPages[owner] * 0x1000;
+    }
+
+    void *AllocatePages(unsigned int order, uint32_t allocFlags) {
+        if (order > MaxPageOrder) return nullptr;
+
+        uintptr_t phys = 0;
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+
+        /* Local node first, then the others by distance */
+        const uint8_t *fallback = GetNodeFallbackList(GetCurrentNode());
+        for (size_t i = 0; i < GetNodeCount() && !phys; i++) {
+            Zone *zone = &Zones[fallback[i]];
+            if (zone->FreePages < ((size_t)1 << order)) continue;
+
+            zone->Lock.Aquire();
+            phys = TakeBlock(zone, order);
+            zone->Lock.Release();
+        }
+
+        CPU::RestoreInterrupts(flags);
+
+        if (!phys) return nullptr;
+
+        ClaimBlock(phys, order);
+
+        /* Zero outside of the lock so other CPUs aren't held up by it */
+        if (!(allocFlags & PAGE_ALLOC_NO_ZERO)) memset((void *)HHDMPhysToVirt(phys), 0, BlockSize(order));
 
-        SpinlockRelease(&PageAlloc_Lock);
-        return ret;
+        return (void *)phys;
+    }
+
+    void FreePages(void *addr, unsigned int order) {
+        uintptr_t phys = (uintptr_t)addr;
+
+        if (!phys || order > MaxPageOrder) return;
+
+        UnclaimBlock(phys, order);
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        ReleaseBlockLocked(phys, order);
+        CPU::RestoreInterrupts(flags);
+    }
+
+    bool IsAllocatedBlock(void *addr, unsigned int order) {
+        if (!addr || order > MaxPageOrder) return false;
+
+        return !CheckFreeable((uintptr_t)addr, order);
+    }
+
+    void *AllocatePage(uint32_t allocFlags) {
+        bool zero = !(allocFlags & PAGE_ALLOC_NO_ZERO);
+        bool usePool = !(allocFlags & PAGE_ALLOC_NO_POOL);
+
+        if (zero && usePool) {
+            uintptr_t page = TakeZeroedPage();
+            if (page) {
+                ClaimBlock(page, 0);
+                return (void *)page;
+            }
+        }
+
+        /* Interrupts stay off while we use the cache so we can't be interrupted half way through */
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        PageCache *cache = &PageCaches.Local();
+
+        /* Refill from the nearest node that still has pages */
+        const uint8_t *fallback = GetNodeFallbackList(GetCurrentNode());
+        for (size_t i = 0; i < GetNodeCount() && !cache->Count; i++) {
+            Zone *zone = &Zones[fallback[i]];
+            if (!zone->FreePages) continue;
+
+            zone->Lock.Aquire();
+            while (cache->Count < PageCacheBatch) {
+                uintptr_t page = TakeBlock(zone, 0);
+                if (!page) break;
+
+                FrameOf(page)->Flags = PAGE_FRAME_CACHED;
+                cache->Pages[cache->Count++] = page;
+            }
+            zone->Lock.Release();
+        }
+
+        uintptr_t phys = cache->Count ? cache->Pages[--cache->Count] : 0;
+        CPU::RestoreInterrupts(flags);
+
+        /* Nothing left but whatever is sitting in the zeroed pool */
+        if (!phys && !zero && usePool) phys = TakeZeroedPage();
+        if (!phys) return nullptr;
+
+        ClaimBlock(phys, 0);
+
+        if (zero) memset((void *)HHDMPhysToVirt(phys), 0, 0x1000);
+        return (void *)phys;
     }
 
-    SPINLOCK_CREATE(PageFree_Lock);
     void FreePage(void *addr) {
-        SpinlockAquire(&PageFree_Lock);
+        uintptr_t phys = (uintptr_t)addr;
+
+        if (!phys) return;
+
+        UnclaimBlock(phys, 0);
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
 
-        void *virt_page = (void *)HHDMPhysToVirt((uintptr_t)addr);
+        /* Keep the caches node-local, a page from another node goes straight back to its own zone */
+        if (FrameOf(phys)->Node != GetCurrentNode()) {
+            ReleaseBlockLocked(phys, 0);
+            CPU::RestoreInterrupts(flags);
+            return;
+        }
+
+        FrameOf(phys)->Flags = PAGE_FRAME_CACHED;
+        PageCache *cache = &PageCaches.Local();
+
+        /* Cache is full, give a batch back to the buddy allocator so it can coalesce */
+        if (cache->Count == PageCacheCapacity) {
+            /* A refill may have fallen back to another node, so each page goes through its own zone's lock */
+            while (cache->Count > PageCacheCapacity - PageCacheBatch) {
+                ReleaseBlockLocked(cache->Pages[--cache->Count], 0);
+            }
+        }
+
+        cache->Pages[cache->Count++] = phys;
+        CPU::RestoreInterrupts(flags);
+    }
+
+    void ReclaimBootMemory(limine_memmap_response mmap) {
+        size_t bootloaderReclaimed = 0;
+        size_t acpiReclaimed = 0;
+
+        for (size_t i = 0; i < mmap.entry_count; i++) {
+            uintptr_t base = mmap.entries[i]->base;
+            uintptr_t end = base + mmap.entries[i]->length;
+
+            switch (mmap.entries[i]->type) {
+                case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE: {
+                    AddRegion(base, end);
+                    bootloaderReclaimed += mmap.entries[i]->length;
+                    break;
+                }
+                case LIMINE_MEMMAP_ACPI_RECLAIMABLE: {
+                    AddRegion(base, end);
+                    acpiReclaimed += mmap.entries[i]->length;
+                    break;
+                }
+            }
+        }
+
+        TotalUsableMemory += bootloaderReclaimed + acpiReclaimed;
+
+        Log(KERNEL_LOG_INFO, "[PMM] Reclaimed %d KiB of bootloader memory and %d KiB of ACPI memory\n", bootloaderReclaimed / 1024, acpiReclaimed / 1024);
+    }
+
+    bool FillZeroedPagePool() {
+        ZeroedPool *pool = &ZeroedPools[GetCurrentNode()];
+        if (pool->Count >= ZeroedPoolCapacity) return false;
 
-        InsertNode(virt_page, 0x1000);
+        /* Taking a page back out of the pool would only zero it again, stop once the buddy allocator runs dry */
+        void *page = AllocatePage(PAGE_ALLOC_NO_ZERO | PAGE_ALLOC_NO_POOL);
+        if (!page) return false;
+
+        memset((void *)HHDMPhysToVirt((uintptr_t)page), 0, 0x1000);
+
+        /* The page stops counting as allocated while it sits in the pool */
+        UnclaimBlock((uintptr_t)page, 0);
+        FrameOf((uintptr_t)page)->Flags = PAGE_FRAME_CACHED;
+
+        bool stored = false;
+        uint64_t flags = pool->Lock.AquireIrqSave();
+        if (pool->Count < ZeroedPoolCapacity) {
+            pool->Pages[pool->Count++] = (uintptr_t)page;
+            stored = true;
+        }
+        pool->Lock.ReleaseIrqRestore(flags);
+
+        /* Another CPU filled the last slot first */
+        if (!stored) {
+            ClaimBlock((uintptr_t)page, 0);
+            FreePage(page);
+        }
 
-        SpinlockRelease(&PageFree_Lock);
+        return stored;
     }
 }
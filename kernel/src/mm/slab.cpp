@@ -0,0 +1,257 @@
+/*
+    * slab.cpp
+    * Slab allocator for fixed-size kernel objects
+    * Created 17/10/2026
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mm/slab.hpp>
+#include <mm/pmm.hpp>
+#include <mm/mem.hpp>
+#include <hal/vmm.hpp>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <libs/kernel.hpp>
+
+using namespace Kernel::Mem;
+
+/* Size classes for SlabAllocate, roughly 1.5x apart so rounding up wastes at most a third */
+static SlabCache SizeCaches[] = {
+    SlabCache("size-16", 16),
+    SlabCache("size-32", 32),
+    SlabCache("size-48", 48),
+    SlabCache("size-64", 64),
+    SlabCache("size-96", 96),
+    SlabCache("size-128", 128),
+    SlabCache("size-192", 192),
+    SlabCache("size-256", 256),
+    SlabCache("size-384", 384),
+    SlabCache("size-512", 512),
+};
+
+constexpr size_t SizeCacheCount = sizeof(SizeCaches) / sizeof(SizeCaches[0]);
+
+/*
+    Per-CPU magazines (thread caches) in front of each size class. Only the
+    owning CPU touches its magazines, the shared cache and its lock are only
+    involved when a magazine runs dry or overflows, in batches.
+*/
+constexpr size_t MagazineCapacity = 32;
+constexpr size_t MagazineBatch = 16;
+
+struct Magazine {
+    size_t Count;
+    void *Objects[MagazineCapacity];
+};
+
+struct CPUMagazines {
+    Magazine Classes[SizeCacheCount];
+}__attribute__((aligned(64)));
+
+static PERCPU_CREATE(CPUMagazines, Magazines);
+
+static inline Slab *SlabOf(void *object) {
+    return (Slab *)ALIGN_DOWN((uintptr_t)object, SlabSize);
+}
+
+namespace Kernel::Mem {
+    void SlabCache::Unlink(Slab **list, Slab *slab) {
+        if (slab->Prev) slab->Prev->Next = slab->Next;
+        else *list = slab->Next;
+
+        if (slab->Next) slab->Next->Prev = slab->Prev;
+    }
+
+    void SlabCache::Push(Slab **list, Slab *slab) {
+        slab->Prev = nullptr;
+        slab->Next = *list;
+        if (*list) (*list)->Prev = slab;
+        *list = slab;
+    }
+
+    /* Carves a fresh page into objects. Called with the cache locked. */
+    Slab *SlabCache::Grow() {
+        void *page = AllocatePage(PAGE_ALLOC_NO_ZERO);
+        if (!page) return nullptr;
+
+        SetPageOwner(page, PAGE_OWNER_SLAB);
+
+        Slab *slab = (Slab *)HHDMPhysToVirt((uintptr_t)page);
+        slab->Cache = this;
+        slab->InUse = 0;
+        slab->FreeList = nullptr;
+
+        /* Thread the free list back to front, so objects get handed out in address order */
+        for (size_t i = ObjectsPerSlab; i > 0; i--) {
+            void **object = (void **)((uintptr_t)slab + FirstObject + (i - 1) * ObjectSize);
+            *object = slab->FreeList;
+            slab->FreeList = object;
+        }
+
+        SlabCount++;
+        Push(&Partial, slab);
+        return slab;
+    }
+
+    /* Called with the cache locked */
+    void *SlabCache::AllocateLocked() {
+        Slab *slab = Partial;
+        if (!slab && Empty) {
+            /* Reuse the spare empty slab before asking the PMM for another page */
+            slab = Empty;
+            Unlink(&Empty, slab);
+            Push(&Partial, slab);
+        }
+
+        if (!slab) slab = Grow();
+        if (!slab) return nullptr;
+
+        void *object = slab->FreeList;
+        slab->FreeList = *(void **)object;
+        slab->InUse++;
+        ObjectCount++;
+
+        if (slab->InUse == ObjectsPerSlab) {
+            Unlink(&Partial, slab);
+            Push(&Full, slab);
+        }
+
+        return object;
+    }
+
+    /* Called with the cache locked. Returns a slab the caller should give back to the PMM once unlocked. */
+    Slab *SlabCache::FreeLocked(void *object) {
+        Slab *slab = SlabOf(object);
+        if (slab->Cache != this) Panic("[SLAB] Object freed to the wrong cache.");
+
+        *(void **)object = slab->FreeList;
+        slab->FreeList = object;
+        ObjectCount--;
+
+        if (slab->InUse-- == ObjectsPerSlab) {
+            Unlink(&Full, slab);
+            Push(&Partial, slab);
+        }
+
+        if (slab->InUse) return nullptr;
+
+        Unlink(&Partial, slab);
+
+        /* Keep one empty slab around so a cache hovering around a slab boundary doesn't thrash the PMM */
+        if (!Empty) {
+            Push(&Empty, slab);
+            return nullptr;
+        }
+
+        SlabCount--;
+        return slab;
+    }
+
+    void *SlabCache::Allocate() {
+        uint64_t flags = Lock.AquireIrqSave();
+        void *object = AllocateLocked();
+        Lock.ReleaseIrqRestore(flags);
+
+        return object;
+    }
+
+    void SlabCache::Free(void *object) {
+        uint64_t flags = Lock.AquireIrqSave();
+        Slab *empty = FreeLocked(object);
+        Lock.ReleaseIrqRestore(flags);
+
+        if (empty) FreePage((void *)HHDMVirtToPhys((uintptr_t)empty));
+    }
+
+    size_t SlabCache::AllocateBatch(void **objects, size_t count) {
+        size_t allocated = 0;
+
+        uint64_t flags = Lock.AquireIrqSave();
+        while (allocated < count) {
+            void *object = AllocateLocked();
+            if (!object) break;
+
+            objects[allocated++] = object;
+        }
+        Lock.ReleaseIrqRestore(flags);
+
+        return allocated;
+    }
+
+    void SlabCache::FreeBatch(void **objects, size_t count) {
+        Slab *empty = nullptr;
+
+        uint64_t flags = Lock.AquireIrqSave();
+        for (size_t i = 0; i < count; i++) {
+            Slab *slab = FreeLocked(objects[i]);
+
+            /* Chain the slabs to give back, the lists are done with them */
+            if (slab) {
+                slab->Next = empty;
+                empty = slab;
+            }
+        }
+        Lock.ReleaseIrqRestore(flags);
+
+        while (empty) {
+            Slab *next = empty->Next;
+            FreePage((void *)HHDMVirtToPhys((uintptr_t)empty));
+            empty = next;
+        }
+    }
+
+    void *SlabAllocate(size_t size) {
+        if (size > MaxSlabObjectSize) return nullptr;
+
+        size_t sizeClass = 0;
+        while (SizeCaches[sizeClass].GetObjectSize() < size) sizeClass++;
+
+        /* Interrupts stay off so the magazine can't be touched by a handler on this CPU half way through */
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        Magazine *magazine = &Magazines.Local().Classes[sizeClass];
+
+        if (!magazine->Count) magazine->Count = SizeCaches[sizeClass].AllocateBatch(magazine->Objects, MagazineBatch);
+
+        void *object = magazine->Count ? magazine->Objects[--magazine->Count] : nullptr;
+        CPU::RestoreInterrupts(flags);
+
+        return object;
+    }
+
+    void SlabFree(void *object) {
+        if (!object) return;
+
+        SlabCache *cache = SlabOf(object)->Cache;
+
+        /* Objects from a dedicated ObjectCache don't go through the magazines */
+        if (cache < &SizeCaches[0] || cache >= &SizeCaches[SizeCacheCount]) {
+            cache->Free(object);
+            return;
+        }
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        Magazine *magazine = &Magazines.Local().Classes[cache - SizeCaches];
+
+        /* Magazine is full, hand the older half back to the cache */
+        if (magazine->Count == MagazineCapacity) {
+            cache->FreeBatch(magazine->Objects, MagazineBatch);
+            magazine->Count -= MagazineBatch;
+            memcpy(magazine->Objects, &magazine->Objects[MagazineBatch], magazine->Count * sizeof(void *));
+        }
+
+        magazine->Objects[magazine->Count++] = object;
+        CPU::RestoreInterrupts(flags);
+    }
+
+    bool IsSlabObject(void *object) {
+        PageFrame *frame = GetPageFrame(HHDMVirtToPhys((uintptr_t)SlabOf(object)));
+
+        return frame && !frame->Flags && frame->Owner == PAGE_OWNER_SLAB;
+    }
+
+    size_t SlabObjectSize(void *object) {
+        return SlabOf(object)->Cache->GetObjectSize();
+    }
+}
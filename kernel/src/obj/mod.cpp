@@ -9,6 +9,8 @@
 #include <hal/vmm.hpp>
 #include <obj/tar.hpp>
 #include <terminal/terminal.hpp>
+#include <libs/string.hpp>
+#include <hal/rwlock.hpp>
 
 extern BootloaderData GlobalBootloaderData;
 
@@ -20,31 +22,47 @@ namespace Kernel::Obj {
 
     Lib::Vector<InternalModule> *Modules;
     TarObject *FirstRamdisk;
+    /* Guards Modules and FirstRamdisk */
+    RWLock ModulesLock {"Modules"};
 
     void HandleModuleObjects(limine_module_response *moduleStructure) {
         if (!moduleStructure) return;
 
-        Modules = new Lib::Vector<InternalModule>();
+        Lib::Vector<InternalModule> *modules = new Lib::Vector<InternalModule>();
 
         for (size_t i = 0; i < moduleStructure->module_count; i++) {
+            /* Modules are KERNEL_AND_MODULES memory, which the kernel's HHDM already covers */
             uintptr_t virtAddr = (uintptr_t)moduleStructure->modules[i]->address;
-            uintptr_t physAddr = virtAddr - GlobalBootloaderData.hhdm_response->offset;
-            size_t size = moduleStructure->modules[i]->size;
 
-            for (size_t i = 0; i < size; i += 4096) {
-                VMM::MemoryMap(nullptr, virtAddr + i, physAddr + i, false);
-            }
+            /* The path lives in bootloader reclaimable memory, keep our own copy */
+            const char *bootPath = moduleStructure->modules[i]->path;
+            char *path = (char *)Mem::Allocate(strlen(bootPath) + 1);
+            strcpy(path, bootPath);
 
-            Modules->push_back(InternalModule {
+            modules->push_back(InternalModule {
                 .VirtualAddress = (void *)virtAddr,
-                .Path = moduleStructure->modules[i]->path,
+                .Path = path,
             });
         }
 
         /* Here, the first module (if it exists) is initialized as a ramdisk. */
         /* Note: This is only temporary. Once we have a VFS and multiple ramdisks can be handled, all ramdisk modules will be set up. */
-        if (Modules->at(0).VirtualAddress) {
-            FirstRamdisk = new TarObject(Modules->at(0).VirtualAddress);
+        TarObject *ramdisk = nullptr;
+        if (modules->size() && modules->at(0).VirtualAddress) {
+            ramdisk = new TarObject(modules->at(0).VirtualAddress);
         }
+
+        ModulesLock.AquireWrite();
+        Modules = modules;
+        FirstRamdisk = ramdisk;
+        ModulesLock.ReleaseWrite();
+    }
+
+    TarObject *GetFirstRamdisk() {
+        ModulesLock.AquireRead();
+        TarObject *ramdisk = FirstRamdisk;
+        ModulesLock.ReleaseRead();
+
+        return ramdisk;
     }
 }
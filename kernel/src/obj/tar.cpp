@@ -86,7 +86,7 @@ namespace Kernel::Obj {
         return File {0, 0, 0, 0, 0};
     }
 
-    Lib::Vector<TarObject::File> TarObject::GetAll() {
+    Lib::Vector<TarObject::File> &TarObject::GetAll() {
         return Files;
     }
 }
@@ -0,0 +1,432 @@
+/*
+    * sched.cpp
+    * Kernel threads and the preemptive scheduler
+    * Created 17/10/2026
+*/
+
+#include <sched/sched.hpp>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/cpu/interrupt/apic.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <mm/slab.hpp>
+#include <libs/kernel.hpp>
+
+/*
+    Every CPU runs threads from its own queue. A CPU with nothing left steals a
+    thread from another CPU's queue, and a CPU that queues a thread while others
+    sit idle wakes one of them up to come and steal it.
+
+    A thread that's switched away from is only queued again (or freed) by the
+    thread that was switched to, in FinishSwitch, so no CPU can pick it up while
+    its stack is still in use.
+*/
+struct RunQueue {
+    /* Test-and-set, taken with interrupts disabled and without touching the preempt count */
+    volatile bool Lock;
+    Kernel::Sched::Thread *Head;
+    Kernel::Sched::Thread *Tail;
+    /* Both read without the lock, to skip queues with nothing to take */
+    size_t Length;
+    size_t Stealable;
+
+    /* The idle thread is waiting for an interrupt, cleared by whoever sends it one */
+    bool Idle;
+    size_t SliceLeft;
+
+    Kernel::Sched::Thread *IdleThread;
+    /* The thread switched away from, for FinishSwitch */
+    Kernel::Sched::Thread *Previous;
+};
+
+static PERCPU_CREATE(RunQueue, RunQueues);
+static Kernel::Sched::Thread IdleThreads[Kernel::CPU::MaxCPUCount];
+static Kernel::Mem::ObjectCache<Kernel::Sched::Thread> ThreadCache("Thread");
+
+extern "C" void SwitchContext(uintptr_t *oldStackPointer, uintptr_t newStackPointer);
+
+namespace Kernel::Sched {
+    static size_t OnlineCPUCount() {
+        size_t count = CPU::GetCPUCount();
+        return count ? count : 1;
+    }
+
+    static void Push(RunQueue *queue, Thread *thread) {
+        SpinlockAquire(&queue->Lock);
+
+        if (thread->Urgent) {
+            thread->Next = queue->Head;
+            queue->Head = thread;
+            if (!queue->Tail) queue->Tail = thread;
+        } else {
+            thread->Next = nullptr;
+            if (queue->Tail) queue->Tail->Next = thread;
+            else queue->Head = thread;
+            queue->Tail = thread;
+        }
+
+        __atomic_store_n(&queue->Length, queue->Length + 1, __ATOMIC_RELAXED);
+        if (thread->Affinity == AnyCPU) __atomic_store_n(&queue->Stealable, queue->Stealable + 1, __ATOMIC_RELAXED);
+
+        SpinlockRelease(&queue->Lock);
+    }
+
+    /* Takes the first thread in the queue, or with steal set the first one that isn't pinned to the queue's CPU */
+    static Thread *Pop(RunQueue *queue, bool steal) {
+        if (!__atomic_load_n(steal ? &queue->Stealable : &queue->Length, __ATOMIC_RELAXED)) return nullptr;
+
+        SpinlockAquire(&queue->Lock);
+
+        Thread *previous = nullptr;
+        Thread *thread = queue->Head;
+        while (thread && steal && thread->Affinity != AnyCPU) {
+            previous = thread;
+            thread = thread->Next;
+        }
+
+        if (thread) {
+            if (previous) previous->Next = thread->Next;
+            else queue->Head = thread->Next;
+            if (queue->Tail == thread) queue->Tail = previous;
+
+            __atomic_store_n(&queue->Length, queue->Length - 1, __ATOMIC_RELAXED);
+            if (thread->Affinity == AnyCPU) __atomic_store_n(&queue->Stealable, queue->Stealable - 1, __ATOMIC_RELAXED);
+        }
+
+        SpinlockRelease(&queue->Lock);
+        return thread;
+    }
+
+    static Thread *Steal(size_t self) {
+        size_t count = OnlineCPUCount();
+
+        /* Start at the next CPU, so thieves spread out over the victims */
+        for (size_t offset = 1; offset < count; offset++) {
+            Thread *thread = Pop(&RunQueues[(self + offset) % count], true);
+            if (thread) return thread;
+        }
+
+        return nullptr;
+    }
+
+    /* Sends the reschedule IPI to a CPU if it's halted, only one sender gets to */
+    static bool Kick(size_t cpu) {
+        if (!__atomic_load_n(&RunQueues[cpu].Idle, __ATOMIC_RELAXED)) return false;
+        if (!__atomic_exchange_n(&RunQueues[cpu].Idle, false, __ATOMIC_ACQ_REL)) return false;
+
+        CPU::SendIPI(CPU::GetCPUApicId(cpu), RescheduleVector);
+        return true;
+    }
+
+    /* Queues a thread on its CPU, or on this one if it may run anywhere. Interrupts must be disabled. */
+    static void Enqueue(Thread *thread) {
+        size_t self = CPU::GetCPUIndex();
+        size_t target = thread->Affinity == AnyCPU ? self : thread->Affinity;
+
+        Push(&RunQueues[target], thread);
+
+        /* The queue has to be visible before looking at who's idle, IdleWait checks the other way around */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (target != self) {
+            Kick(target);
+            return;
+        }
+
+        if (thread->Affinity != AnyCPU) return;
+
+        /* Have an idle CPU come and take it */
+        size_t count = OnlineCPUCount();
+        for (size_t offset = 1; offset < count; offset++) {
+            if (Kick((self + offset) % count)) return;
+        }
+    }
+
+    static void FreeThread(Thread *thread) {
+        CPU::FreeKernelStack(thread->StackTop);
+        ThreadCache.Delete(thread);
+    }
+
+    /* Runs on the thread that was switched to, before anything else, with interrupts disabled */
+    static void FinishSwitch() {
+        RunQueue *queue = &RunQueues.Local();
+        Thread *previous = queue->Previous;
+        queue->Previous = nullptr;
+
+        /* Idle threads aren't queued, they run whenever nothing else does */
+        if (!previous || previous == queue->IdleThread) return;
+
+        ThreadState state = __atomic_load_n(&previous->State, __ATOMIC_ACQUIRE);
+        switch (state) {
+            case THREAD_READY:
+                Enqueue(previous);
+                break;
+            case THREAD_BLOCKING:
+                /* Fails if a Wake came in since, making it READY */
+                if (!__atomic_compare_exchange_n(&previous->State, &state, THREAD_BLOCKED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                    Enqueue(previous);
+                }
+                break;
+            case THREAD_DEAD:
+                FreeThread(previous);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /*
+        Switches to the next thread ready on this CPU, or stolen from another. The current
+        thread goes back in the queue if it's still runnable. Interrupts must be disabled
+        and preemption enabled. Returns whether another thread ran.
+    */
+    static bool Schedule() {
+        CPU::CPUData *cpu = CPU::ThisCPU();
+        RunQueue *queue = &RunQueues[cpu->Index];
+        Thread *current = cpu->CurrentThread;
+
+        cpu->NeedResched = false;
+        queue->SliceLeft = TimeSliceTicks;
+
+        Thread *next = Pop(queue, false);
+        if (!next) next = Steal(cpu->Index);
+
+        ThreadState state = __atomic_load_n(&current->State, __ATOMIC_ACQUIRE);
+        if (!next) {
+            /* Nothing else to run, keep going unless the current thread is leaving (READY means woken before it got off the CPU) */
+            if (state == THREAD_RUNNING || state == THREAD_READY) {
+                __atomic_store_n(&current->State, THREAD_RUNNING, __ATOMIC_RELAXED);
+                return false;
+            }
+
+            if (current == queue->IdleThread) Panic("[SCHED] The idle thread can't block.");
+            next = queue->IdleThread;
+        }
+
+        /* A Wake on a running thread leaves State alone, so nothing races with this store */
+        if (state == THREAD_RUNNING) __atomic_store_n(&current->State, THREAD_READY, __ATOMIC_RELEASE);
+        __atomic_store_n(&next->State, THREAD_RUNNING, __ATOMIC_RELAXED);
+        if (next != queue->IdleThread) __atomic_store_n(&queue->Idle, false, __ATOMIC_RELAXED);
+
+        queue->Previous = current;
+        cpu->CurrentThread = next;
+        SwitchContext(&current->StackPointer, next->StackPointer);
+
+        /* Back on this thread, maybe on another CPU */
+        FinishSwitch();
+        return true;
+    }
+
+    /* Where a new thread's first SwitchContext returns to */
+    static void ThreadStart() {
+        FinishSwitch();
+        CPU::SetInterrupts();
+
+        Thread *thread = GetCurrentThread();
+        thread->Entry(thread->Argument);
+
+        ExitThread();
+    }
+
+    void InitializeCPU() {
+        CPU::CPUData *cpu = CPU::ThisCPU();
+        RunQueue *queue = &RunQueues[cpu->Index];
+        Thread *idle = &IdleThreads[cpu->Index];
+
+        idle->Name = "Idle";
+        idle->State = THREAD_RUNNING;
+        idle->Affinity = cpu->Index;
+
+        queue->IdleThread = idle;
+        queue->SliceLeft = TimeSliceTicks;
+
+        /* From here on the timer may switch threads on this CPU */
+        __atomic_store_n(&cpu->CurrentThread, idle, __ATOMIC_RELEASE);
+    }
+
+    Thread *CreateThread(void (*entry)(void *), void *argument, const char *name, size_t cpu, bool urgent) {
+        if (cpu != AnyCPU && cpu >= OnlineCPUCount()) return nullptr;
+
+        Thread *thread = ThreadCache.New();
+        if (!thread) return nullptr;
+
+        thread->StackTop = CPU::TryAllocateKernelStack();
+        if (!thread->StackTop) {
+            ThreadCache.Delete(thread);
+            return nullptr;
+        }
+
+        thread->Entry = entry;
+        thread->Argument = argument;
+        thread->Name = name;
+        thread->State = THREAD_READY;
+        thread->Affinity = cpu;
+        thread->Urgent = urgent;
+
+        /* Laid out like a SwitchContext, which "returns" into ThreadStart as if it had been called */
+        uintptr_t *stack = (uintptr_t *)thread->StackTop;
+        stack[-1] = 0;
+        stack[-2] = (uintptr_t)ThreadStart;
+        for (size_t i = 3; i <= 8; i++) stack[-i] = 0; // rbp, rbx, r12 - r15
+        thread->StackPointer = (uintptr_t)&stack[-8];
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        Enqueue(thread);
+        CPU::RestoreInterrupts(flags);
+
+        return thread;
+    }
+
+    Thread *GetCurrentThread() {
+        return CPU::ThisCPU()->CurrentThread;
+    }
+
+    void Yield() {
+        /* Nothing to yield to before this CPU starts scheduling */
+        if (!GetCurrentThread()) return;
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        if (CPU::ThisCPU()->PreemptCount) Panic("[SCHED] Yield with preemption disabled.");
+
+        Schedule();
+        CPU::RestoreInterrupts(flags);
+    }
+
+    __attribute__((noreturn)) void ExitThread() {
+        CPU::ClearInterrupts();
+        if (CPU::ThisCPU()->PreemptCount) Panic("[SCHED] Thread exited with preemption disabled.");
+
+        __atomic_store_n(&GetCurrentThread()->State, THREAD_DEAD, __ATOMIC_RELEASE);
+        Schedule();
+
+        Panic("[SCHED] A dead thread was scheduled.");
+    }
+
+    void Block() {
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        if (CPU::ThisCPU()->PreemptCount) Panic("[SCHED] Block with preemption disabled.");
+
+        Thread *current = GetCurrentThread();
+
+        /* Announce the block, then look for a Wake. Wake does the same the other way around, so one of us sees the other. */
+        __atomic_store_n(&current->State, THREAD_BLOCKING, __ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&current->WakePending, false, __ATOMIC_SEQ_CST)) {
+            __atomic_store_n(&current->State, THREAD_RUNNING, __ATOMIC_RELAXED);
+        } else {
+            Schedule();
+        }
+
+        CPU::RestoreInterrupts(flags);
+    }
+
+    void Wake(Thread *thread) {
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+
+        while (true) {
+            ThreadState state = __atomic_load_n(&thread->State, __ATOMIC_SEQ_CST);
+
+            if (state == THREAD_BLOCKED) {
+                /* Off its CPU for good, it's ours to queue */
+                if (__atomic_compare_exchange_n(&thread->State, &state, THREAD_READY, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                    Enqueue(thread);
+                    break;
+                }
+                continue;
+            }
+
+            if (state == THREAD_BLOCKING) {
+                /* Still switching away, FinishSwitch queues it */
+                if (__atomic_compare_exchange_n(&thread->State, &state, THREAD_READY, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) break;
+                continue;
+            }
+
+            if (state == THREAD_DEAD) break;
+
+            /* Running or ready, leave the wake for its next Block */
+            __atomic_store_n(&thread->WakePending, true, __ATOMIC_SEQ_CST);
+
+            state = __atomic_load_n(&thread->State, __ATOMIC_SEQ_CST);
+            if (state != THREAD_BLOCKING && state != THREAD_BLOCKED) break;
+
+            /* It blocked without seeing the flag, take it back and wake it properly. Unless Block took it after all. */
+            if (!__atomic_exchange_n(&thread->WakePending, false, __ATOMIC_SEQ_CST)) break;
+        }
+
+        CPU::RestoreInterrupts(flags);
+    }
+
+    void PreemptPoint() {
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+
+        /*
+            Not from interrupt handlers or other code running with interrupts disabled, the flag
+            stays set and RestoreInterrupts comes back here once they're enabled again
+        */
+        CPU::CPUData *cpu = CPU::ThisCPU();
+        if (!(flags & (1 << 9))) return;
+        if (cpu->CurrentThread && !cpu->PreemptCount) Schedule();
+
+        /* Not RestoreInterrupts, which would call back in here if the flag got set again meanwhile */
+        CPU::SetInterrupts();
+    }
+
+    bool RunReadyThreads() {
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+        bool ran = Schedule();
+        CPU::RestoreInterrupts(flags);
+
+        return ran;
+    }
+
+    void IdleWait() {
+        RunQueue *queue = &RunQueues.Local();
+
+        CPU::ClearInterrupts();
+        __atomic_store_n(&queue->Idle, true, __ATOMIC_SEQ_CST);
+
+        /* A thread queued before the flag was visible won't send an IPI, so look once more */
+        bool work = __atomic_load_n(&queue->Length, __ATOMIC_SEQ_CST);
+        for (size_t i = 0; i < OnlineCPUCount() && !work; i++) {
+            if (__atomic_load_n(&RunQueues[i].Stealable, __ATOMIC_SEQ_CST)) work = true;
+        }
+
+        /* The interrupt shadow of sti keeps anything from coming in before the hlt */
+        if (!work) asm volatile ("sti; hlt" : : : "memory");
+
+        __atomic_store_n(&queue->Idle, false, __ATOMIC_RELAXED);
+        CPU::SetInterrupts();
+    }
+
+    void Tick() {
+        CPU::CPUData *cpu = CPU::ThisCPU();
+        if (!cpu->CurrentThread) return;
+
+        RunQueue *queue = &RunQueues[cpu->Index];
+        if (!cpu->NeedResched && queue->SliceLeft && --queue->SliceLeft) return;
+
+        queue->SliceLeft = TimeSliceTicks;
+        if (!__atomic_load_n(&queue->Length, __ATOMIC_RELAXED)) return;
+
+        if (cpu->PreemptCount) cpu->NeedResched = true;
+        else Schedule();
+    }
+
+    void RequestResched() {
+        CPU::ThisCPU()->NeedResched = true;
+
+        /* Taken as soon as interrupts are enabled again, i.e. right after the handler calling this returns */
+        CPU::SendIPISelf(RescheduleVector);
+    }
+
+    size_t GetRunQueueLength(size_t cpu) {
+        return __atomic_load_n(&RunQueues[cpu].Length, __ATOMIC_RELAXED);
+    }
+
+    __attribute__((interrupt)) void RescheduleInterrupt(CPU::Interrupts::CInterruptRegisters *) {
+        CPU::LAPIC_EOI();
+
+        /* From RequestResched, otherwise another CPU woke us up to look for threads */
+        CPU::CPUData *cpu = CPU::ThisCPU();
+        if (cpu->NeedResched && cpu->CurrentThread && !cpu->PreemptCount) Schedule();
+    }
+}
@@ -0,0 +1,26 @@
+; switch.asm
+; Switches between kernel threads
+
+bits 64
+global SwitchContext
+
+; void SwitchContext(uintptr_t *oldStackPointer, uintptr_t newStackPointer)
+; Only the callee-saved registers need saving, the caller saved everything else.
+SwitchContext:
+    push rbp
+    push rbx
+    push r12
+    push r13
+    push r14
+    push r15
+
+    mov [rdi], rsp
+    mov rsp, rsi
+
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbx
+    pop rbp
+    ret
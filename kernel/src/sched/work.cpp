@@ -0,0 +1,164 @@
+/*
+    * work.cpp
+    * Deferred work for interrupt handlers, and a pool of worker threads
+    * Created 17/10/2026
+*/
+
+#include <sched/work.hpp>
+#include <sched/sched.hpp>
+#include <hal/cpu.hpp>
+#include <hal/spinlock.hpp>
+#include <hal/cpu/smp/smp.hpp>
+#include <terminal/terminal.hpp>
+#include <libs/kernel.hpp>
+
+/* Only touched by its own CPU with interrupts disabled, so it needs no lock */
+struct DeferredQueue {
+    Kernel::Sched::Work *Head;
+    Kernel::Sched::Work *Tail;
+    /* The CPU's bottom-half thread, pinned to it */
+    Kernel::Sched::Thread *Thread;
+};
+
+static PERCPU_CREATE(DeferredQueue, DeferredQueues);
+
+/* Work for the pool, and which workers are blocked waiting for some */
+static Kernel::Spinlock WorkLock("Work queue");
+static Kernel::Sched::Work *WorkHead = nullptr;
+static Kernel::Sched::Work *WorkTail = nullptr;
+static Kernel::Sched::Thread *Workers[Kernel::Sched::MaxWorkers];
+static bool WorkerIdle[Kernel::Sched::MaxWorkers];
+static size_t WorkerCount = 0;
+
+namespace Kernel::Sched {
+    static void Append(Work **head, Work **tail, Work *work) {
+        work->Next = nullptr;
+
+        if (*tail) (*tail)->Next = work;
+        else *head = work;
+        *tail = work;
+    }
+
+    static void Run(Work *work) {
+        void (*function)(void *) = work->Function;
+        void *argument = work->Argument;
+
+        /* From here on the work may be queued again, even by the function itself */
+        __atomic_store_n(&work->Pending, false, __ATOMIC_RELEASE);
+        function(argument);
+    }
+
+    static void BottomHalfThread(void *) {
+        /* Pinned, so this stays our CPU's queue */
+        DeferredQueue *queue = &DeferredQueues.Local();
+
+        while (true) {
+            uint64_t flags = CPU::SaveAndDisableInterrupts();
+            Work *work = queue->Head;
+            queue->Head = queue->Tail = nullptr;
+            CPU::RestoreInterrupts(flags);
+
+            /* A QueueDeferred between the check and the Block isn't lost, its Wake makes the Block return */
+            if (!work) {
+                Block();
+                continue;
+            }
+
+            while (work) {
+                Work *next = work->Next;
+                Run(work);
+                work = next;
+            }
+        }
+    }
+
+    static void WorkerThread(void *argument) {
+        size_t index = (size_t)argument;
+
+        while (true) {
+            uint64_t flags = WorkLock.AquireIrqSave();
+
+            Work *work = WorkHead;
+            if (work) {
+                WorkHead = work->Next;
+                if (!WorkHead) WorkTail = nullptr;
+            } else {
+                WorkerIdle[index] = true;
+            }
+
+            WorkLock.ReleaseIrqRestore(flags);
+
+            if (!work) {
+                Block();
+                continue;
+            }
+
+            Run(work);
+        }
+    }
+
+    void InitializeWorkQueues() {
+        size_t cpus = CPU::GetCPUCount() ? CPU::GetCPUCount() : 1;
+
+        for (size_t i = 0; i < cpus; i++) {
+            Thread *thread = CreateThread(BottomHalfThread, nullptr, "Bottom half", i, true);
+            if (!thread) Panic("[WORK] Unable to create a bottom-half thread.");
+
+            /* Work queued on that CPU before now gets picked up once the thread first runs */
+            __atomic_store_n(&DeferredQueues[i].Thread, thread, __ATOMIC_RELEASE);
+        }
+
+        size_t workers = cpus < MaxWorkers ? cpus : MaxWorkers;
+        for (size_t i = 0; i < workers; i++) {
+            Thread *thread = CreateThread(WorkerThread, (void *)i, "Worker");
+            if (!thread) Panic("[WORK] Unable to create a worker thread.");
+
+            uint64_t flags = WorkLock.AquireIrqSave();
+            Workers[i] = thread;
+            WorkerCount = i + 1;
+            WorkLock.ReleaseIrqRestore(flags);
+        }
+
+        Log(KERNEL_LOG_SUCCESS, "[WORK] %d bottom-half threads and %d workers started.\n", cpus, workers);
+    }
+
+    bool QueueDeferred(Work *work) {
+        if (__atomic_exchange_n(&work->Pending, true, __ATOMIC_ACQ_REL)) return false;
+
+        uint64_t flags = CPU::SaveAndDisableInterrupts();
+
+        DeferredQueue *queue = &DeferredQueues.Local();
+        Append(&queue->Head, &queue->Tail, work);
+
+        Thread *thread = __atomic_load_n(&queue->Thread, __ATOMIC_ACQUIRE);
+        if (thread) {
+            Wake(thread);
+            RequestResched();
+        }
+
+        CPU::RestoreInterrupts(flags);
+        return true;
+    }
+
+    bool QueueWork(Work *work) {
+        if (__atomic_exchange_n(&work->Pending, true, __ATOMIC_ACQ_REL)) return false;
+
+        uint64_t flags = WorkLock.AquireIrqSave();
+        Append(&WorkHead, &WorkTail, work);
+
+        Thread *worker = nullptr;
+        for (size_t i = 0; i < WorkerCount; i++) {
+            if (WorkerIdle[i]) {
+                WorkerIdle[i] = false;
+                worker = Workers[i];
+                break;
+            }
+        }
+
+        WorkLock.ReleaseIrqRestore(flags);
+
+        /* Busy workers take it when they're done otherwise */
+        if (worker) Wake(worker);
+        return true;
+    }
+}
@@ -90,9 +90,9 @@ static char* hexToString(uint64_t value, char* buffer, size_t n) {
 
 
 namespace Kernel {
-    SPINLOCK_CREATE(PutCharLock);
+    Spinlock PutCharLock("PutChar");
     void PutChar(char c) {
-        SpinlockAquire(&PutCharLock);
+        PutCharLock.Aquire();
         flanterm_write(fb_ctx, &c, 1);
         if (TargetPort) {
             if (c == '\n') {
@@ -100,7 +100,7 @@ namespace Kernel {
             }
             TargetPort->WriteCharacter(c);
         }
-        SpinlockRelease(&PutCharLock);
+        PutCharLock.Release();
     }
     
     namespace Init {
@@ -131,21 +131,21 @@ namespace Kernel {
         }
     }
 
-    SPINLOCK_CREATE(PrintLock);
+    Spinlock PrintLock("Print");
     void Print(const char *string)
     {
-        SpinlockAquire(&PrintLock);
+        PrintLock.Aquire();
         while (*string != '\0') {
             PutChar(*string);
             string++;
         }
-        SpinlockRelease(&PrintLock);
+        PrintLock.Release();
     }
 
-    SPINLOCK_CREATE(LogSpinlock);
+    Spinlock LogSpinlock("Log");
     void Log(KernelLogType type, const char *format, ...)
     {
-        SpinlockAquire(&LogSpinlock);
+        LogSpinlock.Aquire();
         
         switch (type) {
             case KERNEL_LOG_SUCCESS:
@@ -203,6 +203,6 @@ namespace Kernel {
         }
 
         va_end(args);
-        SpinlockRelease(&LogSpinlock);
+        LogSpinlock.Release();
     }
 }